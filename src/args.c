@@ -1,5 +1,6 @@
 #include "args.h"
 #include "consts.h"
+#include "romdb.h"
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
@@ -7,12 +8,27 @@
 
 void usage() { 
     printf("Usage: ./chip8 [OPTIONS] <rom file>\n"); 
+    printf("       ./chip8 --wall [OPTIONS] <rom file>...\n");
     printf("\nOptions:\n");
     printf("    -d, --debug            Run the debugger\n");
     printf("    -s, --scale [SCALE]    Set window scale (Default 10, minimum 1)\n");
     printf("    -f [COLOUR]            Set Foreground colour (See Below)\n");
     printf("    -b [COLOUR]            Set Background colour (See Below)\n");
     printf("    -c, --cycles [CYCLES]  Target CPU cycles per second\n");
+    printf("    -m, --mode [MODE]      Instruction set to run, chip8, schip or xochip (Default chip8)\n");
+    printf("    -q, --quirks [QUIRKS]  Quirk profile, vip, schip or xo (Default matches the mode)\n");
+    printf("    -r, --run-ahead [N]    Show frames N ahead to hide input lag (Default 0, maximum %d)\n", MAXIMUM_RUN_AHEAD);
+    printf("    --turbo [N]            Start fast forwarding at N times speed, 0 for as fast as possible (Default %d)\n", DEFAULT_TURBO);
+    printf("    --rom-db [PATH]        ROM database with per ROM speed, quirks and colours (Default %s)\n", DEFAULT_ROM_DATABASE);
+    printf("    --trace-out [FILE]     Write a Chrome trace of every frame's phases\n");
+    printf("    --shm [NAME]           Share frames and keys with other processes through shared memory\n");
+    printf("    --serve [SOCKET]       Run headless, streaming frames and taking keys on a Unix socket\n");
+    printf("    --tty                  Draw in the terminal instead of a window\n");
+    printf("    --wall                 Tile every ROM given in one window, Tab or click to pick the one to play\n");
+    printf("    --capture [FILE]       Write every frame as Y4M video at the window scale, - for stdout\n");
+    printf("    --capture-raw          Capture raw RGBA frames instead of Y4M\n");
+    printf("    --sessions [N]         Run N headless copies of the ROM on a pool of worker threads\n");
+    printf("    --workers [N]          Worker threads for --sessions (Default one per core)\n");
 
 
     printf("\nAvailable Colours:\n");
@@ -37,12 +53,32 @@ void usage() {
 int read_args(Args *args, int argc, char *argv[]) {
     // Set the defaults 
     args->rom = NULL;
+    args->roms = NULL;
+    args->num_of_roms = 0;
+    args->wall = false;
+    args->rom_database = DEFAULT_ROM_DATABASE;
+    args->trace_out = NULL;
+    args->shm = NULL;
+    args->serve = NULL;
+    args->capture = NULL;
+    args->capture_raw = false;
+    args->sessions = 0;
+    args->workers = 0;
     args->debug = false;
+    args->tty = false;
     args->help = false;
     args->scale = DEFAULT_SCALE;
     args->foreground = WHITE;
     args->background = BLACK;
     args->target_cycles = DEFAULT_TARGET_CYCLES_PER_SECOND;
+    args->run_ahead = 0;
+    args->turbo = DEFAULT_TURBO;
+    args->fast_forward = false;
+    args->mode = MODE_CHIP8;
+    args->custom_cycles = false;
+    args->custom_quirks = false;
+    args->custom_foreground = false;
+    args->custom_background = false;
 
     for (int i = 1; i < argc; i++) {
         if (argv[i][0] == '-') {
@@ -74,6 +110,138 @@ int read_args(Args *args, int argc, char *argv[]) {
                     return 1;
                 }
                 args->target_cycles = (uint32_t) cycles;
+                args->custom_cycles = true;
+            } else if (strcmp(argv[i], "--mode") == 0 || strcmp(argv[i], "-m") == 0) {
+                i++;
+                if (i == argc) {
+                    printf("ERROR: Mode not provided\n");
+                    return 1;
+                }
+
+                if (strcmp(argv[i], "chip8") == 0) {
+                    args->mode = MODE_CHIP8;
+                } else if (strcmp(argv[i], "schip") == 0) {
+                    args->mode = MODE_SCHIP;
+                } else if (strcmp(argv[i], "xochip") == 0) {
+                    args->mode = MODE_XOCHIP;
+                } else {
+                    printf("ERROR: Invalid mode %s\n", argv[i]);
+                    return 1;
+                }
+            } else if (strcmp(argv[i], "--quirks") == 0 || strcmp(argv[i], "-q") == 0) {
+                i++;
+                if (i == argc) {
+                    printf("ERROR: Quirk profile not provided\n");
+                    return 1;
+                }
+
+                if (strcmp(argv[i], "vip") == 0) {
+                    args->quirks = QUIRKS_VIP;
+                } else if (strcmp(argv[i], "schip") == 0) {
+                    args->quirks = QUIRKS_SCHIP;
+                } else if (strcmp(argv[i], "xo") == 0) {
+                    args->quirks = QUIRKS_XO;
+                } else {
+                    printf("ERROR: Invalid quirk profile %s\n", argv[i]);
+                    return 1;
+                }
+                args->custom_quirks = true;
+            } else if (strcmp(argv[i], "--run-ahead") == 0 || strcmp(argv[i], "-r") == 0) {
+                i++;
+                if (i == argc) {
+                    printf("ERROR: Run ahead parameter not provided\n");
+                    return 1;
+                }
+                
+                long frames = strtol(argv[i], NULL, 10);
+                if (frames < 0 || frames > MAXIMUM_RUN_AHEAD) {
+                    printf("ERROR: Run ahead must be between 0 and %d\n", MAXIMUM_RUN_AHEAD);
+                    return 1;
+                }
+                args->run_ahead = (uint32_t) frames;
+            } else if (strcmp(argv[i], "--turbo") == 0) {
+                i++;
+                if (i == argc) {
+                    printf("ERROR: Turbo speed not provided\n");
+                    return 1;
+                }
+
+                // 0 is the most extreme setting, so a typo mustn't parse as it
+                char *end;
+                long turbo = strtol(argv[i], &end, 10);
+                if (end == argv[i] || *end != '\0' || turbo < 0 || turbo > MAXIMUM_TURBO) {
+                    printf("ERROR: Turbo must be between 0 and %d\n", MAXIMUM_TURBO);
+                    return 1;
+                }
+                args->turbo = (uint32_t) turbo;
+                args->fast_forward = true;
+            } else if (strcmp(argv[i], "--rom-db") == 0) {
+                i++;
+                if (i == argc) {
+                    printf("ERROR: ROM database path not provided\n");
+                    return 1;
+                }
+                args->rom_database = argv[i];
+            } else if (strcmp(argv[i], "--trace-out") == 0) {
+                i++;
+                if (i == argc) {
+                    printf("ERROR: Trace file not provided\n");
+                    return 1;
+                }
+                args->trace_out = argv[i];
+            } else if (strcmp(argv[i], "--shm") == 0) {
+                i++;
+                if (i == argc) {
+                    printf("ERROR: Shared memory name not provided\n");
+                    return 1;
+                }
+                args->shm = argv[i];
+            } else if (strcmp(argv[i], "--serve") == 0) {
+                i++;
+                if (i == argc) {
+                    printf("ERROR: Socket path not provided\n");
+                    return 1;
+                }
+                args->serve = argv[i];
+            } else if (strcmp(argv[i], "--capture") == 0) {
+                i++;
+                if (i == argc) {
+                    printf("ERROR: Capture file not provided\n");
+                    return 1;
+                }
+                args->capture = argv[i];
+            } else if (strcmp(argv[i], "--sessions") == 0) {
+                i++;
+                if (i == argc) {
+                    printf("ERROR: Number of sessions not provided\n");
+                    return 1;
+                }
+
+                long sessions = strtol(argv[i], NULL, 10);
+                if (sessions <= 0 || sessions > MAXIMUM_SESSIONS) {
+                    printf("ERROR: Sessions must be between 1 and %d\n", MAXIMUM_SESSIONS);
+                    return 1;
+                }
+                args->sessions = (int) sessions;
+            } else if (strcmp(argv[i], "--workers") == 0) {
+                i++;
+                if (i == argc) {
+                    printf("ERROR: Number of workers not provided\n");
+                    return 1;
+                }
+
+                long workers = strtol(argv[i], NULL, 10);
+                if (workers <= 0 || workers > MAXIMUM_WORKERS) {
+                    printf("ERROR: Workers must be between 1 and %d\n", MAXIMUM_WORKERS);
+                    return 1;
+                }
+                args->workers = (int) workers;
+            } else if (strcmp(argv[i], "--wall") == 0) {
+                args->wall = true;
+            } else if (strcmp(argv[i], "--tty") == 0) {
+                args->tty = true;
+            } else if (strcmp(argv[i], "--capture-raw") == 0) {
+                args->capture_raw = true;
             } else if (strcmp(argv[i], "-f") == 0) {
                 i++;
                 if (i == argc) {
@@ -88,6 +256,7 @@ int read_args(Args *args, int argc, char *argv[]) {
                 }
                 
                 args->foreground = (uint32_t) colour;
+                args->custom_foreground = true;
             } else if (strcmp(argv[i], "-b") == 0) {
                 i++;
                 if (i == argc) {
@@ -102,6 +271,7 @@ int read_args(Args *args, int argc, char *argv[]) {
                 }
                 
                 args->background = (uint32_t) colour;
+                args->custom_background = true;
             } else if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
                 args->help = true;
             } else {
@@ -110,12 +280,53 @@ int read_args(Args *args, int argc, char *argv[]) {
             }
         } else {
             args->rom = argv[i];
+            args->roms = &argv[i];
+            args->num_of_roms = argc - i;
             // We do not expect any more arguments after the rom
             // So we should stop processing them
             break;
         }
     }
 
+    if (args->wall && (args->num_of_roms == 0 || args->tty || args->serve != NULL || args->debug)) {
+        printf("ERROR: --wall needs at least one ROM and can't be used with --tty, --serve or the debugger\n");
+        return 1;
+    }
+
+    // The wall has no emulation thread to share, capture or trace
+    if (args->wall && (args->shm != NULL || args->capture != NULL || args->trace_out != NULL)) {
+        printf("ERROR: --wall can't be used with --shm, --capture or --trace-out\n");
+        return 1;
+    }
+
+    if (args->sessions > 0 && (args->wall || args->tty || args->serve != NULL || args->debug)) {
+        printf("ERROR: --sessions can't be used with --wall, --tty, --serve or the debugger\n");
+        return 1;
+    }
+
+    // Sessions only run on the scheduler, none of the single instance machinery applies
+    if (args->sessions > 0 && (args->capture != NULL || args->trace_out != NULL || args->fast_forward ||
+                               args->run_ahead > 0)) {
+        printf("ERROR: --sessions can't be used with --capture, --trace-out, --turbo or --run-ahead\n");
+        return 1;
+    }
+
+    if (args->tty && (args->serve != NULL || args->debug)) {
+        printf("ERROR: --tty can't be used with --serve or the debugger\n");
+        return 1;
+    }
+
+    // Each mode defaults to the quirks of the interpreter that defined it
+    if (!args->custom_quirks) {
+        if (args->mode == MODE_XOCHIP) {
+            args->quirks = QUIRKS_XO;
+        } else if (args->mode == MODE_SCHIP) {
+            args->quirks = QUIRKS_SCHIP;
+        } else {
+            args->quirks = QUIRKS_VIP;
+        }
+    }
+
     return 0;
 }
 
@@ -6,12 +6,44 @@
 
 typedef struct {
   char *rom;
+  // Every ROM on the command line, only --wall runs more than the first
+  char **roms;
+  int num_of_roms;
+  bool wall;
+  char *rom_database;
+  // Chrome trace event file, NULL to disable tracing
+  char *trace_out;
+  // Shared memory segment to publish frames to, NULL to disable
+  char *shm;
+  // Unix socket to stream frames on instead of opening a window, NULL for a window
+  char *serve;
+  // File to write every frame to, - for stdout, NULL to disable
+  char *capture;
+  bool capture_raw;
+  // Headless copies of the ROM to run on the scheduler, 0 for a single instance
+  int sessions;
+  // Worker threads for the sessions, 0 for one per core
+  int workers;
   bool debug;
+  // Draw in the terminal rather than a window
+  bool tty;
   bool help;
   uint32_t scale;
   uint32_t foreground;
   uint32_t background;
   uint32_t target_cycles;
+  uint32_t run_ahead;
+  // Emulated frames per displayed frame while fast forwarding, TURBO_UNCAPPED for as fast as possible
+  uint32_t turbo;
+  // Start fast forwarding, set by --turbo
+  bool fast_forward;
+  uint8_t mode;
+  uint8_t quirks;
+  // Set when given on the command line, these take priority over the ROM database
+  bool custom_cycles;
+  bool custom_quirks;
+  bool custom_foreground;
+  bool custom_background;
 } Args;
 
 void usage();
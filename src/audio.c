@@ -0,0 +1,173 @@
+#include <SDL2/SDL.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "audio.h"
+#include "consts.h"
+#include "ring.h"
+
+// PolyBLEP correction, smooths the square wave's steps to keep it band-limited
+static double poly_blep(double t, double dt) {
+    if (t < dt) {
+        t /= dt;
+        return t + t - t * t - 1.0;
+    }
+
+    if (t > 1.0 - dt) {
+        t = (t - 1.0) / dt;
+        return t * t + t + t + 1.0;
+    }
+
+    return 0.0;
+}
+
+// XO-CHIP patterns are played a bit at a time, most significant bit first
+static double next_pattern_value(Audio *audio) {
+    int bit = (int) audio->pattern_position;
+    double value = (audio->pattern[bit / 8] >> (7 - bit % 8)) & 1 ? 1.0 : -1.0;
+
+    audio->pattern_position += audio->pattern_step;
+    if (audio->pattern_position >= AUDIO_PATTERN_BITS) audio->pattern_position -= AUDIO_PATTERN_BITS;
+
+    return value;
+}
+
+static double next_square_value(Audio *audio) {
+    double dt = audio->phase_step;
+    double half = audio->phase + 0.5;
+    if (half >= 1.0) half -= 1.0;
+
+    double value = audio->phase < 0.5 ? 1.0 : -1.0;
+    value += poly_blep(audio->phase, dt);
+    value -= poly_blep(half, dt);
+
+    audio->phase += dt;
+    if (audio->phase >= 1.0) audio->phase -= 1.0;
+
+    return value;
+}
+
+static float next_sample(Audio *audio) {
+    double value = audio->patterned ? next_pattern_value(audio) : next_square_value(audio);
+
+    // Ramp the gain rather than switching instantly to avoid clicks
+    float target = audio->buzzing ? 1.0f : 0.0f;
+    float ramp = 1.0f / (AUDIO_SAMPLE_RATE / 1000);
+    if (audio->gain < target) {
+        audio->gain = audio->gain + ramp > target ? target : audio->gain + ramp;
+    } else if (audio->gain > target) {
+        audio->gain = audio->gain - ramp < target ? target : audio->gain - ramp;
+    }
+
+    return (float) value * audio->gain * AUDIO_VOLUME;
+}
+
+static void apply_event(Audio *audio, BuzzerEvent const *event) {
+    audio->buzzing = event->on;
+    audio->patterned = event->patterned;
+
+    if (event->patterned) {
+        memcpy(audio->pattern, event->pattern, sizeof(audio->pattern));
+        // Pitch 64 plays 4000 bits a second, every 48 steps doubles it
+        double rate = AUDIO_PATTERN_RATE * pow(2.0, (event->pitch - DEFAULT_PITCH) / 48.0);
+        audio->pattern_step = rate / audio->sample_rate;
+    }
+}
+
+// Runs on SDL's audio thread, so no locks and no allocation in here
+static void audio_callback(void *userdata, Uint8 *stream, int len) {
+    Audio *audio = userdata;
+    float *out = (float *) stream;
+    int samples = len / sizeof(float);
+    double position = audio->position;
+    BuzzerEvent event;
+
+    // Trail the emulator by a fixed latency, only snapping back when we've drifted (e.g. after a pause)
+    double target = (double) atomic_load_explicit(&audio->frame, memory_order_relaxed) - AUDIO_LATENCY_FRAMES;
+    double drift = position - target;
+    if (drift < -AUDIO_MAX_DRIFT_FRAMES || drift > AUDIO_MAX_DRIFT_FRAMES) {
+        position = target;
+    }
+
+    for (int i = 0; i < samples; i++) {
+        // Events keep their spacing in emulated frames, late ones play straight away
+        while (ring_peek(&audio->events, &event)) {
+            if ((double) event.frame > position) break;
+
+            ring_pop(&audio->events, &event);
+            apply_event(audio, &event);
+        }
+
+        out[i] = next_sample(audio);
+        position += audio->frames_per_sample;
+    }
+
+    audio->position = position;
+}
+
+bool init_audio(Audio *audio) {
+    SDL_AudioSpec want = { 0 };
+    SDL_AudioSpec have;
+
+    audio->position = 0;
+    atomic_init(&audio->frame, 0);
+    audio->phase = 0;
+    audio->gain = 0;
+    audio->buzzing = false;
+    audio->patterned = false;
+    audio->pattern_step = 0;
+    audio->pattern_position = 0;
+
+    if (!init_ring_buffer(&audio->events, AUDIO_EVENT_CAPACITY, sizeof(BuzzerEvent))) {
+        printf("Failed to allocate audio event queue\n");
+        return false;
+    }
+
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) < 0) {
+        printf("SDL audio could not initialize! SDL_Error: %s\n", SDL_GetError());
+        cleanup_ring_buffer(&audio->events);
+        return false;
+    }
+
+    // A small buffer keeps the latency down to a few milliseconds
+    want.freq = AUDIO_SAMPLE_RATE;
+    want.format = AUDIO_F32SYS;
+    want.channels = 1;
+    want.samples = AUDIO_BUFFER_SAMPLES;
+    want.callback = audio_callback;
+    want.userdata = audio;
+
+    audio->device = SDL_OpenAudioDevice(NULL, 0, &want, &have, 0);
+    if (audio->device == 0) {
+        printf("Audio device could not be opened! SDL_Error: %s\n", SDL_GetError());
+        SDL_QuitSubSystem(SDL_INIT_AUDIO);
+        cleanup_ring_buffer(&audio->events);
+        return false;
+    }
+
+    audio->frames_per_sample = (double) TARGET_FRAMES_PER_SECOND / have.freq;
+    audio->phase_step = (double) AUDIO_TONE_FREQUENCY / have.freq;
+    audio->sample_rate = have.freq;
+
+    SDL_PauseAudioDevice(audio->device, 0);
+
+    return true;
+}
+
+void cleanup_audio(Audio *audio) {
+    SDL_CloseAudioDevice(audio->device);
+    audio->device = 0;
+    SDL_QuitSubSystem(SDL_INIT_AUDIO);
+    cleanup_ring_buffer(&audio->events);
+}
+
+void advance_audio_clock(Audio *audio, uint64_t frame) {
+    atomic_store_explicit(&audio->frame, frame, memory_order_relaxed);
+}
+
+bool queue_buzzer(Audio *audio, BuzzerEvent const *event) {
+    return ring_push(&audio->events, event);
+}
@@ -0,0 +1,48 @@
+#ifndef AUDIO_H_
+#define AUDIO_H_
+
+#include <SDL2/SDL.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "consts.h"
+#include "ring.h"
+
+typedef struct {
+    // Emulated frame the transition happened on
+    uint64_t frame;
+    bool on;
+    // XO-CHIP audio pattern, played instead of the square wave when loaded
+    bool patterned;
+    uint8_t pitch;
+    uint8_t pattern[AUDIO_PATTERN_SIZE];
+} BuzzerEvent;
+
+typedef struct {
+    SDL_AudioDeviceID device;
+    // Buzzer transitions from the emulation thread
+    RingBuffer events;
+    // Newest emulated frame, the callback trails it by AUDIO_LATENCY_FRAMES
+    _Atomic uint64_t frame;
+    double frames_per_sample;
+    double phase_step;
+    int sample_rate;
+
+    // Only touched by the audio callback
+    double position;
+    double phase;
+    float gain;
+    bool buzzing;
+    bool patterned;
+    double pattern_step;
+    double pattern_position;
+    uint8_t pattern[AUDIO_PATTERN_SIZE];
+} Audio;
+
+bool init_audio(Audio *audio);
+void cleanup_audio(Audio *audio);
+void advance_audio_clock(Audio *audio, uint64_t frame);
+// Never blocks, returns false if the callback has fallen too far behind to take it
+bool queue_buzzer(Audio *audio, BuzzerEvent const *event);
+
+#endif
@@ -0,0 +1,224 @@
+#include "capture.h"
+#include "consts.h"
+#include "frame.h"
+#include "render.h"
+#include "ring.h"
+#include "timing.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+static char const FRAME_HEADER[] = "FRAME\n";
+
+// BT.601 studio range, packed as Y | U << 8 | V << 16 so expand_screen can place it like a colour
+static uint32_t rgba_to_yuv(uint32_t colour) {
+    double r = (colour >> 24) & 0xFF;
+    double g = (colour >> 16) & 0xFF;
+    double b = (colour >> 8) & 0xFF;
+
+    uint32_t y = 16.5 + (65.481 * r + 128.553 * g + 24.966 * b) / 255.0;
+    uint32_t u = 128.5 + (-37.797 * r - 74.203 * g + 112.0 * b) / 255.0;
+    uint32_t v = 128.5 + (112.0 * r - 93.786 * g - 18.214 * b) / 255.0;
+
+    return y | u << 8 | v << 16;
+}
+
+static bool same_frame(Frame const *a, Frame const *b) {
+    return a->planes == b->planes && a->hires == b->hires &&
+           memcmp(a->colours, b->colours, sizeof(a->colours)) == 0 &&
+           memcmp(a->screen, b->screen, a->planes * sizeof(a->screen[0])) == 0;
+}
+
+static void encode(Capture *capture, Frame const *frame, uint8_t *out) {
+    uint32_t colours[NUM_OF_COLOURS];
+    int width = frame->hires ? HIRES_SCREEN_WIDTH : SCREEN_WIDTH;
+    int height = frame->hires ? HIRES_SCREEN_HEIGHT : SCREEN_HEIGHT;
+    int scale = frame->hires ? capture->scale : capture->scale * 2;
+
+    if (capture->raw) {
+        // Byte swapped so the bytes land in R, G, B, A order on little endian hosts
+        for (int i = 0; i < NUM_OF_COLOURS; i++) {
+            colours[i] = __builtin_bswap32(frame->colours[i]);
+        }
+        expand_screen(frame->screen, frame->planes, width, height, colours, out, capture->width * sizeof(uint32_t), scale);
+        return;
+    }
+
+    for (int i = 0; i < NUM_OF_COLOURS; i++) {
+        colours[i] = rgba_to_yuv(frame->colours[i]);
+    }
+    expand_screen(frame->screen, frame->planes, width, height, colours, capture->pixels,
+                  capture->width * sizeof(uint32_t), scale);
+
+    size_t pixels = (size_t) capture->width * capture->height;
+    for (size_t i = 0; i < pixels; i++) {
+        uint32_t yuv = capture->pixels[i];
+        out[i] = yuv;
+        out[pixels + i] = yuv >> 8;
+        out[pixels * 2 + i] = yuv >> 16;
+    }
+}
+
+static bool write_all(int fd, struct iovec *vectors, int count) {
+    while (count > 0) {
+        ssize_t written = writev(fd, vectors, count);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+
+        // Skip what went out, a partial write can end mid vector
+        while (count > 0 && (size_t) written >= vectors->iov_len) {
+            written -= vectors->iov_len;
+            vectors++;
+            count--;
+        }
+        if (count > 0) {
+            vectors->iov_base = (uint8_t *) vectors->iov_base + written;
+            vectors->iov_len -= written;
+        }
+    }
+
+    return true;
+}
+
+// Encodes as many queued frames as there are spare buffers and writes them in one go.
+// Returns the number of frames written
+static int write_batch(Capture *capture) {
+    struct iovec vectors[CAPTURE_MAX_FRAMES_PER_WRITE * 2];
+    Frame *frame = &capture->next;
+    int count = 0;
+    int frames = 0;
+    int encoded = 0;
+
+    // The last frame's buffer is never reused within a batch, so identical frames can point at it
+    while (frames < CAPTURE_MAX_FRAMES_PER_WRITE && ring_peek(&capture->frames, frame)) {
+        if (capture->last_buffer < 0 || !same_frame(frame, &capture->last)) {
+            if (encoded == CAPTURE_BUFFERS - 1) break;
+
+            capture->last_buffer = (capture->last_buffer + 1) % CAPTURE_BUFFERS;
+            encode(capture, frame, capture->buffers[capture->last_buffer]);
+            memcpy(&capture->last, frame, sizeof(Frame));
+            encoded++;
+        }
+        ring_pop(&capture->frames, frame);
+
+        if (!capture->raw) {
+            vectors[count++] = (struct iovec) { (void *) FRAME_HEADER, sizeof(FRAME_HEADER) - 1 };
+        }
+        vectors[count++] = (struct iovec) { capture->buffers[capture->last_buffer], capture->frame_size };
+        frames++;
+    }
+
+    if (count > 0 && !write_all(capture->fd, vectors, count)) {
+        fprintf(stderr, "Capture failed: %s\n", strerror(errno));
+        atomic_store(&capture->failed, true);
+    }
+
+    return frames;
+}
+
+static void *writer_thread(void *arg) {
+    Capture *capture = arg;
+
+    while (!atomic_load(&capture->failed)) {
+        if (write_batch(capture) > 0) continue;
+        if (atomic_load(&capture->stop)) break;
+
+        sleep_until_nanoseconds(now_nanoseconds() + NANOSECS_IN_SECOND / 1000);
+    }
+
+    return NULL;
+}
+
+static void free_buffers(Capture *capture) {
+    for (int i = 0; i < CAPTURE_BUFFERS; i++) {
+        free(capture->buffers[i]);
+        capture->buffers[i] = NULL;
+    }
+    free(capture->pixels);
+    capture->pixels = NULL;
+}
+
+bool start_capture(Capture *capture, char const *path, bool raw, int scale) {
+    capture->raw = raw;
+    capture->scale = scale;
+    capture->width = HIRES_SCREEN_WIDTH * scale;
+    capture->height = HIRES_SCREEN_HEIGHT * scale;
+    capture->frame_size = (size_t) capture->width * capture->height * (raw ? 4 : 3);
+    capture->last_buffer = -1;
+    capture->pixels = malloc((size_t) capture->width * capture->height * sizeof(uint32_t));
+
+    bool allocated = capture->pixels != NULL;
+    for (int i = 0; i < CAPTURE_BUFFERS; i++) {
+        capture->buffers[i] = malloc(capture->frame_size);
+        allocated &= capture->buffers[i] != NULL;
+    }
+
+    if (!allocated || !init_ring_buffer(&capture->frames, CAPTURE_QUEUE_FRAMES, sizeof(Frame))) {
+        printf("Failed to allocate capture buffers\n");
+        free_buffers(capture);
+        return false;
+    }
+
+    if (strcmp(path, "-") == 0) {
+        // Keep our own messages out of the video
+        fflush(stdout);
+        capture->fd = dup(STDOUT_FILENO);
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+    } else {
+        capture->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    }
+
+    if (capture->fd < 0) {
+        printf("Failed to open capture file %s\n", path);
+        cleanup_ring_buffer(&capture->frames);
+        free_buffers(capture);
+        return false;
+    }
+
+    if (!raw) {
+        char header[64];
+        int length = snprintf(header, sizeof(header), "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", capture->width,
+                              capture->height, TARGET_FRAMES_PER_SECOND);
+        struct iovec vector = { header, length };
+        write_all(capture->fd, &vector, 1);
+    }
+
+    atomic_init(&capture->stop, false);
+    atomic_init(&capture->failed, false);
+
+    if (pthread_create(&capture->writer, NULL, writer_thread, capture) != 0) {
+        printf("Failed to start capture writer\n");
+        close(capture->fd);
+        cleanup_ring_buffer(&capture->frames);
+        free_buffers(capture);
+        return false;
+    }
+
+    return true;
+}
+
+void capture_frame(Capture *capture, Frame const *frame) {
+    while (!ring_push(&capture->frames, frame)) {
+        if (atomic_load_explicit(&capture->failed, memory_order_relaxed)) return;
+        sleep_until_nanoseconds(now_nanoseconds() + NANOSECS_IN_SECOND / 1000);
+    }
+}
+
+void stop_capture(Capture *capture) {
+    atomic_store(&capture->stop, true);
+    pthread_join(capture->writer, NULL);
+
+    close(capture->fd);
+    cleanup_ring_buffer(&capture->frames);
+    free_buffers(capture);
+}
@@ -0,0 +1,45 @@
+#ifndef CAPTURE_H_
+#define CAPTURE_H_
+
+#include "consts.h"
+#include "frame.h"
+#include "ring.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Writes every frame as Y4M video (4:4:4) or raw RGBA, 128x64 times the scale with low
+// resolution frames doubled. Encoding and writing happen on a thread of its own
+typedef struct {
+    int fd;
+    bool raw;
+    int scale;
+    int width;
+    int height;
+    size_t frame_size;
+    // Frames from the emulation thread waiting to be written
+    RingBuffer frames;
+    // Encoded frames, a frame identical to the one before reuses its buffer
+    uint8_t *buffers[CAPTURE_BUFFERS];
+    // Each pixel's packed Y, U and V before they're split into planes
+    uint32_t *pixels;
+    // The frame being looked at and the last one encoded, too big for the writer's stack
+    Frame next;
+    Frame last;
+    int last_buffer;
+    pthread_t writer;
+    _Atomic bool stop;
+    // Set when writing fails, the emulator stops capturing rather than waiting forever
+    _Atomic bool failed;
+} Capture;
+
+// path - writes to stdout, everything else printed then goes to stderr
+bool start_capture(Capture *capture, char const *path, bool raw, int scale);
+// Waits for room rather than dropping the frame if the writer is behind
+void capture_frame(Capture *capture, Frame const *frame);
+// Writes out everything still queued and closes the output
+void stop_capture(Capture *capture);
+
+#endif
@@ -1,15 +1,66 @@
 #include "chip8.h"
+#include "hash.h"
 #include "io.h"
 #include "debug.h"
 #include "structs.h"
 #include "consts.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include <time.h>
+#include <unistd.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
+// Handlers with quirks are inlined into each profile's interpreter,
+// they still get an external definition for anyone calling them directly
+#define SPECIALISED inline __attribute__((always_inline))
+
+static void (*select_profile(uint8_t quirks))(Chip8 *chip);
+
+// Memory sizes are powers of two, so wrapping an address around the end is a mask
+static inline uint8_t read_memory(Chip8 const *chip, uint32_t address) {
+    return chip->memory[address & (chip->memory_size - 1)];
+}
+
+Chip8 *create_chip8(Debugger *debug, uint8_t mode, uint8_t quirks, uint32_t foreground, uint32_t background) {
+    // Only XO-CHIP needs the full 64KB, everything else gets by with 4KB
+    uint32_t memory_size = mode >= MODE_XOCHIP ? XOCHIP_MEMORY_SIZE : MEMORY_SIZE;
+
+    Chip8 *chip = malloc(sizeof(Chip8) + memory_size);
+    if (chip == NULL) {
+        printf("ERROR: Failed to assign memory for Chip8!\n");
+        return NULL;
+    }
+
+    chip->mode = mode;
+    chip->quirks = quirks;
+    chip->memory_size = memory_size;
+    init_chip8(chip, debug, foreground, background);
+
+    return chip;
+}
+
+void set_quirks(Chip8 *chip, uint8_t quirks) {
+    chip->quirks = quirks;
+    chip->execute = select_profile(quirks);
+}
+
+size_t chip8_size(Chip8 const *chip) {
+    return sizeof(Chip8) + chip->memory_size;
+}
+
 void init_chip8(Chip8 *chip, Debugger *debug, uint32_t foreground, uint32_t background) {
+    set_quirks(chip, chip->quirks);
+    chip->rom_hash = 0;
+    // Nothing is known to match a pristine image yet
+    chip->dirty_pages = UINT64_MAX;
+    chip->hires = false;
+    chip->planes = 1;
+    chip->pitch = DEFAULT_PITCH;
+    chip->audio_pattern_loaded = false;
     chip->delay_timer = 0;
     chip->sound_timer = 0;
     chip->pc = 0;
@@ -22,14 +73,19 @@ void init_chip8(Chip8 *chip, Debugger *debug, uint32_t foreground, uint32_t back
     chip->display_interrupt_triggered = false;
     chip->keys_pressed = 0;
     chip->keys_snapshot = 0;
+    chip->waiting_for_key = false;
     
-    memset(chip->memory, 0, sizeof(chip->memory));
+    memset(chip->memory, 0, chip->memory_size);
+    memset(chip->audio_pattern, 0, sizeof(chip->audio_pattern));
     memset(chip->registers, 0, sizeof(chip->registers));
     memset(chip->stack, 0, sizeof(chip->stack));
+    memset(chip->rpl_flags, 0, sizeof(chip->rpl_flags));
 
     // Call 00E0 to keep the clear screen behaviour consistent
     debug(chip->debugger, printf("Initializing Screen with 00E0\n"));
+    chip->planes = (1 << NUM_OF_PLANES) - 1;
     exec_00E0(chip);
+    chip->planes = 1;
     
     // Load font into memory
     uint8_t fontset[FONTSET_SIZE] = { 
@@ -55,8 +111,33 @@ void init_chip8(Chip8 *chip, Debugger *debug, uint32_t foreground, uint32_t back
         chip->memory[FONT_START_MEMORY_ADDR + i] = fontset[i]; 
     } 
 
+    // SCHIP adds a 8x10 font for the digits, XO-CHIP extends it to A-F
+    uint8_t big_fontset[BIG_FONTSET_SIZE] = {
+        0x3C, 0x7E, 0xE7, 0xC3, 0xC3, 0xC3, 0xC3, 0xE7, 0x7E, 0x3C, // 0
+        0x18, 0x38, 0x58, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x3C, // 1
+        0x3E, 0x7F, 0xC3, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xFF, 0xFF, // 2
+        0x3C, 0x7E, 0xC3, 0x03, 0x0E, 0x0E, 0x03, 0xC3, 0x7E, 0x3C, // 3
+        0x06, 0x0E, 0x1E, 0x36, 0x66, 0xC6, 0xFF, 0xFF, 0x06, 0x06, // 4
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFE, 0x03, 0xC3, 0x7E, 0x3C, // 5
+        0x3E, 0x7C, 0xC0, 0xC0, 0xFC, 0xFE, 0xC3, 0xC3, 0x7E, 0x3C, // 6
+        0xFF, 0xFF, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x60, 0x60, // 7
+        0x3C, 0x7E, 0xC3, 0xC3, 0x7E, 0x7E, 0xC3, 0xC3, 0x7E, 0x3C, // 8
+        0x3C, 0x7E, 0xC3, 0xC3, 0x7F, 0x3F, 0x03, 0x03, 0x3E, 0x7C, // 9
+        0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+        0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, // B
+        0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, // C
+        0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // E
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0  // F
+    };
+
+    if (chip->mode >= MODE_SCHIP) {
+        memcpy(chip->memory + BIG_FONT_START_MEMORY_ADDR, big_fontset, BIG_FONTSET_SIZE);
+    }
+
     // Seed random generator for CXNN instruction
-    srand(time(NULL));
+    // It lives in the Chip8 so copies of the machine replay identically
+    chip->random_state = (uint32_t) time(NULL) | 1;
 }
 
 void cleanup_chip8(Chip8 *chip) {
@@ -65,51 +146,134 @@ void cleanup_chip8(Chip8 *chip) {
         chip->debugger = NULL;
     }
     
-    chip = NULL;
+    free(chip);
+}
+
+// Only set the PC once a ROM is in, it shouldn't point to anything otherwise
+static void finish_loading(Chip8 *chip, size_t size) {
+    // The ROM replaces whatever was there, so a reset has to put those pages back too
+    for (size_t page = ROM_START_MEMORY_ADDR / DIRTY_PAGE_SIZE; page * DIRTY_PAGE_SIZE < ROM_START_MEMORY_ADDR + size; page++) {
+        chip->dirty_pages |= 1ULL << page;
+    }
+
+    chip->pc = ROM_START_MEMORY_ADDR;
+    chip->rom_hash = xxh64(chip->memory + ROM_START_MEMORY_ADDR, size, 0);
+}
+
+int load_rom_from_buffer(Chip8 *chip, uint8_t const *rom, size_t size) {
+    size_t capacity = chip->memory_size - ROM_START_MEMORY_ADDR;
+
+    if (size > capacity) {
+        printf("ROM is %zu bytes, only %zu fit in memory\n", size, capacity);
+        return 1;
+    }
+
+    memcpy(chip->memory + ROM_START_MEMORY_ADDR, rom, size);
+    finish_loading(chip, size);
+
+    return 0;
 }
 
 int load_rom(Chip8 *chip, char *rom_filename) {
-    uint8_t buffer[100] = { 0 };
-    int memory_ptr = ROM_START_MEMORY_ADDR;
-    FILE *fp = NULL;
-    int result = 0;
+    struct stat info;
+    size_t capacity = chip->memory_size - ROM_START_MEMORY_ADDR;
 
-    fp = fopen(rom_filename, "r");
-    if (fp == NULL) {
+    int fd = open(rom_filename, O_RDONLY);
+    if (fd < 0) {
         printf("Failed to open rom file %s\n", rom_filename);
         return 1;
     }
 
-    while(!feof(fp)) {
-        unsigned long read = fread(&buffer, sizeof(chip->memory[0]), 100, fp);  
+    // Check the size up front so we never read more than fits
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        printf("Rom file %s is not a regular file\n", rom_filename);
+        close(fd);
+        return 1;
+    }
 
-        for (int i = 0; i < read; i++) {
-            chip->memory[memory_ptr] = buffer[i];
-            memory_ptr++;
+    if ((size_t) info.st_size > capacity) {
+        printf("Error reading rom file %s. It is %lld bytes, only %zu fit in memory\n",
+               rom_filename, (long long) info.st_size, capacity);
+        close(fd);
+        return 1;
+    }
 
-            if (memory_ptr == 4096) {
-                printf("Error reading rom file %s. Out of memory\n", rom_filename);
-                result = 1;
-                break; 
-            }
+    // Read straight into memory, usually this is a single call
+    size_t size = info.st_size;
+    size_t loaded = 0;
+    while (loaded < size) {
+        ssize_t result = read(fd, chip->memory + ROM_START_MEMORY_ADDR + loaded, size - loaded);
+        if (result < 0 && errno == EINTR) continue;
+
+        if (result <= 0) {
+            printf("Error reading rom file %s\n", rom_filename);
+            close(fd);
+            return 1;
         }
 
-        if (result != 0) break; 
-    } 
+        loaded += result;
+    }
+
+    close(fd);
+    finish_loading(chip, size);
+
+    return 0;
+}
 
-    fclose(fp);
+void copy_chip8(Chip8 *destination, Chip8 const *source) {
+    // Everything is held inline, so a snapshot is a single bulk copy.
+    // Both machines must have been created with the same mode
+    memcpy(destination, source, chip8_size(source));
+}
 
-    // If successful set the PC to the start of the ROM
-    // We could argue this should be set in init_chip8 since it's the same everytime
-    // Setting it here because the PC shouldn't point to anything if the rom wasn't loaded
-    if (!result) {
-        chip->pc = ROM_START_MEMORY_ADDR;
+Chip8 *create_pristine_image(Chip8 *chip) {
+    Chip8 *pristine = malloc(chip8_size(chip));
+    if (pristine == NULL) {
+        printf("ERROR: Failed to assign memory for pristine image!\n");
+        return NULL;
     }
-    
-    return result;
+
+    chip->dirty_pages = 0;
+    copy_chip8(pristine, chip);
+
+    return pristine;
 }
 
-void cycle(Chip8 *chip) {
+void reset_chip8(Chip8 *chip, Chip8 const *pristine) {
+    uint64_t dirty = chip->dirty_pages;
+    int pages = chip->memory_size / DIRTY_PAGE_SIZE;
+
+    // Registers, timers and the screen are small enough to always copy.
+    // This also brings back the pristine image's clean dirty_pages
+    memcpy(chip, pristine, sizeof(Chip8));
+
+    // Memory only needs the pages the program has written to since
+    for (int page = 0; page < pages && dirty != 0; page++, dirty >>= 1) {
+        if (dirty & 1) {
+            memcpy(chip->memory + page * DIRTY_PAGE_SIZE, pristine->memory + page * DIRTY_PAGE_SIZE, DIRTY_PAGE_SIZE);
+        }
+    }
+}
+
+void start_frame(Chip8 *chip) {
+    update_timers(chip);
+
+    if (chip->waiting_to_draw > 2) {
+        chip->display_interrupt_triggered = true;
+    }
+}
+
+void run_frame(Chip8 *chip, uint64_t cycles_per_frame) {
+    start_frame(chip);
+
+    for (uint64_t i = 0; i < cycles_per_frame; i++) {
+        cycle(chip);
+    }
+}
+
+// Shared body of every profile's interpreter. It's always inlined with a constant
+// Quirks, so each profile gets its own copy with the quirk checks folded away
+static inline __attribute__((always_inline)) void execute(Chip8 *chip, Quirks const quirks) {
     Instruction instruction = { 0 };
 
     // Fetch and Decode the next instruction
@@ -128,8 +292,58 @@ void cycle(Chip8 *chip) {
                 case 0x00EE:
                     exec_00EE(chip);
                     break;
-                // 0NNN Execute Machine Routine. Skipped
+                // 00FB Scroll Right (SCHIP)
+                case 0x00FB:
+                    if (chip->mode >= MODE_SCHIP) {
+                        exec_00FB(chip);
+                    } else {
+                        printf("Skipping 0%X%X%X instruction\n", instruction.x, instruction.y, instruction.n);
+                    }
+                    break;
+                // 00FC Scroll Left (SCHIP)
+                case 0x00FC:
+                    if (chip->mode >= MODE_SCHIP) {
+                        exec_00FC(chip);
+                    } else {
+                        printf("Skipping 0%X%X%X instruction\n", instruction.x, instruction.y, instruction.n);
+                    }
+                    break;
+                // 00FD Exit (SCHIP)
+                case 0x00FD:
+                    if (chip->mode >= MODE_SCHIP) {
+                        exec_00FD(chip);
+                    } else {
+                        printf("Skipping 0%X%X%X instruction\n", instruction.x, instruction.y, instruction.n);
+                    }
+                    break;
+                // 00FE Low Resolution (SCHIP)
+                case 0x00FE:
+                    if (chip->mode >= MODE_SCHIP) {
+                        exec_00FE(chip);
+                    } else {
+                        printf("Skipping 0%X%X%X instruction\n", instruction.x, instruction.y, instruction.n);
+                    }
+                    break;
+                // 00FF High Resolution (SCHIP)
+                case 0x00FF:
+                    if (chip->mode >= MODE_SCHIP) {
+                        exec_00FF(chip);
+                    } else {
+                        printf("Skipping 0%X%X%X instruction\n", instruction.x, instruction.y, instruction.n);
+                    }
+                    break;
                 default:
+                    // 00CN Scroll Down (SCHIP)
+                    if (instruction.y == 0xC && instruction.x == 0 && chip->mode >= MODE_SCHIP) {
+                        exec_00CN(chip, instruction.n);
+                        break;
+                    }
+                    // 00DN Scroll Up (XO-CHIP)
+                    if (instruction.y == 0xD && instruction.x == 0 && chip->mode >= MODE_XOCHIP) {
+                        exec_00DN(chip, instruction.n);
+                        break;
+                    }
+                    // 0NNN Execute Machine Routine. Skipped
                     printf("Skipping 0%X%X%X instruction\n", instruction.x, instruction.y, instruction.n);
                     break;
             }
@@ -154,6 +368,12 @@ void cycle(Chip8 *chip) {
             if (instruction.n == 0) {
                 // 5XY0 Skip if VX = VY 
                 exec_5XY0(chip, instruction.x, instruction.y);
+            } else if (instruction.n == 2 && chip->mode >= MODE_XOCHIP) {
+                // 5XY2 Store VX to VY (XO-CHIP)
+                exec_5XY2(chip, instruction.x, instruction.y);
+            } else if (instruction.n == 3 && chip->mode >= MODE_XOCHIP) {
+                // 5XY3 Load VX to VY (XO-CHIP)
+                exec_5XY3(chip, instruction.x, instruction.y);
             } else {
                 printf("UNDEFINED INSTRUCTION %X%X%X%X\n", instruction.instruction, instruction.x, instruction.y, instruction.n);
             }
@@ -174,15 +394,15 @@ void cycle(Chip8 *chip) {
                     break;
                 case 0x1:
                     // 8XY1 Binary Or
-                    exec_8XY1(chip, instruction.x, instruction.y);
+                    exec_8XY1(chip, instruction.x, instruction.y, quirks);
                     break;
                 case 0x2:
                     // 8XY2 Binary And
-                    exec_8XY2(chip, instruction.x, instruction.y);
+                    exec_8XY2(chip, instruction.x, instruction.y, quirks);
                     break;
                 case 0x3:
                     // 8XY3 Binary XOR
-                    exec_8XY3(chip, instruction.x, instruction.y);
+                    exec_8XY3(chip, instruction.x, instruction.y, quirks);
                     break;
                 case 0x4:
                     // 8XY4 And
@@ -194,7 +414,7 @@ void cycle(Chip8 *chip) {
                     break;
                 case 0x6:
                     // 8XY6 Shift Right
-                    exec_8XY6(chip, instruction.x, instruction.y);
+                    exec_8XY6(chip, instruction.x, instruction.y, quirks);
                     break;
                 case 0x7:
                     // 8XY7 Subtract (VY - VX)
@@ -202,7 +422,7 @@ void cycle(Chip8 *chip) {
                     break;
                 case 0xE:
                     // 8XYE Shift Left
-                    exec_8XYE(chip, instruction.x, instruction.y);
+                    exec_8XYE(chip, instruction.x, instruction.y, quirks);
                     break;
                 default:
                     printf("UNDEFINED INSTRUCTION %X%X%X%X\n", instruction.instruction, instruction.x, instruction.y, instruction.n);
@@ -223,15 +443,20 @@ void cycle(Chip8 *chip) {
             break; 
         case 0xB:
             // BNNN Jump with offset
-            exec_BNNN(chip, instruction.nnn);     
+            exec_BNNN(chip, instruction.nnn, quirks);     
             break; 
         case 0xC:
             // CXNN Random
             exec_CXNN(chip, instruction.x, instruction.nn);     
             break; 
         case 0xD:
-            // DXYN Display 
-            exec_DXYN(chip, instruction.x, instruction.y, instruction.n);
+            if (instruction.n == 0 && chip->mode >= MODE_SCHIP) {
+                // DXY0 Display 16x16 (SCHIP)
+                exec_DXY0(chip, instruction.x, instruction.y, quirks);
+            } else {
+                // DXYN Display 
+                exec_DXYN(chip, instruction.x, instruction.y, instruction.n, quirks);
+            }
             chip->waiting_to_draw++;
             break;
         case 0xE:
@@ -247,6 +472,38 @@ void cycle(Chip8 *chip) {
             break;
         case 0xF:
             switch (instruction.nn) {
+                case 0x00:
+                    // F000 NNNN Load I with a 16 bit address (XO-CHIP)
+                    if (instruction.x == 0 && chip->mode >= MODE_XOCHIP) {
+                        exec_F000(chip);
+                    } else {
+                        printf("UNDEFINED INSTRUCTION %X%X%X%X\n", instruction.instruction, instruction.x, instruction.y, instruction.n);
+                    }
+                    break;
+                case 0x01:
+                    // FN01 Select Planes (XO-CHIP)
+                    if (chip->mode >= MODE_XOCHIP) {
+                        exec_FN01(chip, instruction.x);
+                    } else {
+                        printf("UNDEFINED INSTRUCTION %X%X%X%X\n", instruction.instruction, instruction.x, instruction.y, instruction.n);
+                    }
+                    break;
+                case 0x02:
+                    // F002 Load Audio Pattern (XO-CHIP)
+                    if (instruction.x == 0 && chip->mode >= MODE_XOCHIP) {
+                        exec_F002(chip);
+                    } else {
+                        printf("UNDEFINED INSTRUCTION %X%X%X%X\n", instruction.instruction, instruction.x, instruction.y, instruction.n);
+                    }
+                    break;
+                case 0x3A:
+                    // FX3A Set Pitch (XO-CHIP)
+                    if (chip->mode >= MODE_XOCHIP) {
+                        exec_FX3A(chip, instruction.x);
+                    } else {
+                        printf("UNDEFINED INSTRUCTION %X%X%X%X\n", instruction.instruction, instruction.x, instruction.y, instruction.n);
+                    }
+                    break;
                 case 0x07:
                     // FX07 Read Delay Timer
                     exec_FX07(chip, instruction.x);
@@ -277,11 +534,35 @@ void cycle(Chip8 *chip) {
                     break;
                 case 0x55:
                     // FX55 Store Memory
-                    exec_FX55(chip, instruction.x);
+                    exec_FX55(chip, instruction.x, quirks);
                     break;
                 case 0x65:
                     // FX65 Load Memory
-                    exec_FX65(chip, instruction.x);
+                    exec_FX65(chip, instruction.x, quirks);
+                    break;
+                case 0x30:
+                    // FX30 Big Font Character (SCHIP)
+                    if (chip->mode >= MODE_SCHIP) {
+                        exec_FX30(chip, instruction.x);
+                    } else {
+                        printf("UNDEFINED INSTRUCTION %X%X%X%X\n", instruction.instruction, instruction.x, instruction.y, instruction.n);
+                    }
+                    break;
+                case 0x75:
+                    // FX75 Store RPL Flags (SCHIP)
+                    if (chip->mode >= MODE_SCHIP) {
+                        exec_FX75(chip, instruction.x);
+                    } else {
+                        printf("UNDEFINED INSTRUCTION %X%X%X%X\n", instruction.instruction, instruction.x, instruction.y, instruction.n);
+                    }
+                    break;
+                case 0x85:
+                    // FX85 Load RPL Flags (SCHIP)
+                    if (chip->mode >= MODE_SCHIP) {
+                        exec_FX85(chip, instruction.x);
+                    } else {
+                        printf("UNDEFINED INSTRUCTION %X%X%X%X\n", instruction.instruction, instruction.x, instruction.y, instruction.n);
+                    }
                     break;
                 default:
                     printf("UNDEFINED INSTRUCTION %X%X%X%X\n", instruction.instruction, instruction.x, instruction.y, instruction.n);
@@ -294,12 +575,63 @@ void cycle(Chip8 *chip) {
     }
 }
 
+static Quirks const QUIRK_PROFILES[] = {
+    // Original COSMAC VIP interpreter
+    [QUIRKS_VIP] = {
+        .vf_reset = true, .shift_vy = true, .memory_increment = true,
+        .display_wait = true, .clip = true, .jump_vx = false
+    },
+    // SUPER-CHIP 1.1 on the HP48
+    [QUIRKS_SCHIP] = {
+        .vf_reset = false, .shift_vy = false, .memory_increment = false,
+        .display_wait = false, .clip = true, .jump_vx = true
+    },
+    // Octo's XO-CHIP
+    [QUIRKS_XO] = {
+        .vf_reset = false, .shift_vy = true, .memory_increment = true,
+        .display_wait = false, .clip = false, .jump_vx = false
+    }
+};
+
+// Indexing the const table with a constant folds to the profile at compile time
+static void cycle_vip(Chip8 *chip) {
+    execute(chip, QUIRK_PROFILES[QUIRKS_VIP]);
+}
+
+static void cycle_schip(Chip8 *chip) {
+    execute(chip, QUIRK_PROFILES[QUIRKS_SCHIP]);
+}
+
+static void cycle_xo(Chip8 *chip) {
+    execute(chip, QUIRK_PROFILES[QUIRKS_XO]);
+}
+
+Quirks quirk_profile(uint8_t quirks) {
+    return quirks <= QUIRKS_XO ? QUIRK_PROFILES[quirks] : QUIRK_PROFILES[QUIRKS_VIP];
+}
+
+static void (*select_profile(uint8_t quirks))(Chip8 *chip) {
+    switch (quirks) {
+        case QUIRKS_SCHIP:
+            return cycle_schip;
+        case QUIRKS_XO:
+            return cycle_xo;
+        default:
+            return cycle_vip;
+    }
+}
+
+void cycle(Chip8 *chip) {
+    chip->execute(chip);
+}
+
 void decode(Chip8 *chip, Instruction *instruction) {
-    instruction->instruction = (chip->memory[chip->pc] & 240)>>4;
-    instruction->x = chip->memory[chip->pc] & 15;
+    uint8_t high = read_memory(chip, chip->pc);
+    instruction->instruction = (high & 240)>>4;
+    instruction->x = high & 15;
     instruction->nnn = ((uint16_t) instruction->x)<<8;
 
-    instruction->nn = chip->memory[chip->pc + 1];
+    instruction->nn = read_memory(chip, chip->pc + 1);
     instruction->y = (instruction->nn & 240)>>4;
     instruction->n = instruction->nn & 15;
     instruction->nnn |= (uint16_t) instruction->nn;
@@ -319,14 +651,124 @@ void update_timers(Chip8 *chip) {
     }
 }
 
+// Every store the program makes goes through here so reset_chip8 knows which pages to restore.
+// Addresses wrap around the end of memory rather than running off it
+static inline void write_memory(Chip8 *chip, uint32_t address, uint8_t value) {
+    address &= chip->memory_size - 1;
+    chip->memory[address] = value;
+    chip->dirty_pages |= 1ULL << (address / DIRTY_PAGE_SIZE);
+}
+
+// Skip the next instruction, in XO-CHIP that might be the 4 byte F000 NNNN
+static void skip_instruction(Chip8 *chip) {
+    if (chip->mode >= MODE_XOCHIP && read_memory(chip, chip->pc) == 0xF0 && read_memory(chip, chip->pc + 1) == 0x00) {
+        chip->pc += 2;
+    }
+
+    chip->pc += 2;
+}
+
 // Instruction Implementations 
 void exec_00E0(Chip8 *chip) {
     debug(chip->debugger, halt_if_breakpoint(chip, "00E0"));
-    // Since the colours are configurable we can't use memset
-    for (int i = 0; i < SCREEN_SIZE; i++) {
-        chip->screen[i] = chip->background_colour;
+    // The screen only holds pixel state, colours are applied when presenting
+    for (int plane = 0; plane < NUM_OF_PLANES; plane++) {
+        if (chip->planes & (1 << plane)) {
+            memset(chip->screen[plane], 0, sizeof(chip->screen[plane]));
+        }
+    }
+}
+  
+static int screen_width(Chip8 const *chip) {
+    return chip->hires ? HIRES_SCREEN_WIDTH : SCREEN_WIDTH;
+}
+
+static int screen_height(Chip8 const *chip) {
+    return chip->hires ? HIRES_SCREEN_HEIGHT : SCREEN_HEIGHT;
+}
+
+void exec_00CN(Chip8 *chip, uint8_t n) {
+    debug(chip->debugger, halt_if_breakpoint(chip, "00CN"));
+    int height = screen_height(chip);
+
+    if (n > height) n = height;
+
+    // Whole rows move at once, so this is just a copy
+    for (int plane = 0; plane < NUM_OF_PLANES; plane++) {
+        if (!(chip->planes & (1 << plane))) continue;
+
+        memmove(chip->screen[plane][n], chip->screen[plane][0], (height - n) * sizeof(chip->screen[plane][0]));
+        memset(chip->screen[plane][0], 0, n * sizeof(chip->screen[plane][0]));
+    }
+}
+
+void exec_00DN(Chip8 *chip, uint8_t n) {
+    debug(chip->debugger, halt_if_breakpoint(chip, "00DN"));
+    int height = screen_height(chip);
+
+    if (n > height) n = height;
+
+    for (int plane = 0; plane < NUM_OF_PLANES; plane++) {
+        if (!(chip->planes & (1 << plane))) continue;
+
+        memmove(chip->screen[plane][0], chip->screen[plane][n], (height - n) * sizeof(chip->screen[plane][0]));
+        memset(chip->screen[plane][height - n], 0, n * sizeof(chip->screen[plane][0]));
+    }
+}
+
+void exec_00FB(Chip8 *chip) {
+    debug(chip->debugger, halt_if_breakpoint(chip, "00FB"));
+    int words = screen_width(chip) / ROW_WORD_BITS;
+
+    // Shift each row 4 pixels right a word at a time, carrying bits into the next word
+    for (int plane = 0; plane < NUM_OF_PLANES; plane++) {
+        if (!(chip->planes & (1 << plane))) continue;
+
+        for (int y = 0; y < screen_height(chip); y++) {
+            uint64_t carry = 0;
+            for (int w = 0; w < words; w++) {
+                uint64_t word = chip->screen[plane][y][w];
+                chip->screen[plane][y][w] = (word >> 4) | carry;
+                carry = word << 60;
+            }
+        }
+    }
+}
+
+void exec_00FC(Chip8 *chip) {
+    debug(chip->debugger, halt_if_breakpoint(chip, "00FC"));
+    int words = screen_width(chip) / ROW_WORD_BITS;
+
+    // Shift each row 4 pixels left a word at a time, carrying bits into the previous word
+    for (int plane = 0; plane < NUM_OF_PLANES; plane++) {
+        if (!(chip->planes & (1 << plane))) continue;
+
+        for (int y = 0; y < screen_height(chip); y++) {
+            uint64_t carry = 0;
+            for (int w = words - 1; w >= 0; w--) {
+                uint64_t word = chip->screen[plane][y][w];
+                chip->screen[plane][y][w] = (word << 4) | carry;
+                carry = word >> 60;
+            }
+        }
     }
 }
+
+void exec_00FD(Chip8 *chip) {
+    debug(chip->debugger, halt_if_breakpoint(chip, "00FD"));
+    // There's no interpreter to return to, so stay on this instruction
+    chip->pc -= 2;
+}
+
+void exec_00FE(Chip8 *chip) {
+    debug(chip->debugger, halt_if_breakpoint(chip, "00FE"));
+    chip->hires = false;
+}
+
+void exec_00FF(Chip8 *chip) {
+    debug(chip->debugger, halt_if_breakpoint(chip, "00FF"));
+    chip->hires = true;
+}
   
 void exec_00EE(Chip8 *chip) {
     debug(chip->debugger, halt_if_breakpoint(chip, "00EE"));
@@ -358,7 +800,7 @@ void exec_3XNN(Chip8 *chip, uint8_t x, uint8_t nn) {
     debug(chip->debugger, halt_if_breakpoint(chip, "3XNN"));
     
     if (chip->registers[x] == nn) {
-        chip->pc += 2;   
+        skip_instruction(chip);   
     }
 }
    
@@ -366,7 +808,7 @@ void exec_4XNN(Chip8 *chip, uint8_t x, uint8_t nn) {
     debug(chip->debugger, halt_if_breakpoint(chip, "4XNN"));
 
     if (chip->registers[x] != nn) {
-        chip->pc += 2;   
+        skip_instruction(chip);   
     }
 }
    
@@ -374,7 +816,7 @@ void exec_5XY0(Chip8 *chip, uint8_t x, uint8_t y) {
     debug(chip->debugger, halt_if_breakpoint(chip, "5XY0"));
 
     if (chip->registers[x] == chip->registers[y]) {
-        chip->pc += 2;   
+        skip_instruction(chip);   
     }
 }
    
@@ -395,22 +837,22 @@ void exec_8XY0(Chip8 *chip, uint8_t x, uint8_t y) {
     chip->registers[x] = chip->registers[y];
 }
 
-void exec_8XY1(Chip8 *chip, uint8_t x, uint8_t y) {
+SPECIALISED void exec_8XY1(Chip8 *chip, uint8_t x, uint8_t y, Quirks quirks) {
     debug(chip->debugger, halt_if_breakpoint(chip, "8XY1"));
     chip->registers[x] = chip->registers[x] | chip->registers[y];
-    chip->registers[0xF] = 0;
+    if (quirks.vf_reset) chip->registers[0xF] = 0;
 }
 
-void exec_8XY2(Chip8 *chip, uint8_t x, uint8_t y) {
+SPECIALISED void exec_8XY2(Chip8 *chip, uint8_t x, uint8_t y, Quirks quirks) {
     debug(chip->debugger, halt_if_breakpoint(chip, "8XY2"));
     chip->registers[x] = chip->registers[x] & chip->registers[y];
-    chip->registers[0xF] = 0;
+    if (quirks.vf_reset) chip->registers[0xF] = 0;
 }
 
-void exec_8XY3(Chip8 *chip, uint8_t x, uint8_t y) {
+SPECIALISED void exec_8XY3(Chip8 *chip, uint8_t x, uint8_t y, Quirks quirks) {
     debug(chip->debugger, halt_if_breakpoint(chip, "8XY3"));
     chip->registers[x] = chip->registers[x] ^ chip->registers[y];
-    chip->registers[0xF] = 0;
+    if (quirks.vf_reset) chip->registers[0xF] = 0;
 }
 
 void exec_8XY4(Chip8 *chip, uint8_t x, uint8_t y) {
@@ -438,11 +880,11 @@ void exec_8XY5(Chip8 *chip, uint8_t x, uint8_t y) {
     }
 }
 
-void exec_8XY6(Chip8 *chip, uint8_t x, uint8_t y) {
+SPECIALISED void exec_8XY6(Chip8 *chip, uint8_t x, uint8_t y, Quirks quirks) {
     debug(chip->debugger, halt_if_breakpoint(chip, "8XY6"));
     
-    // Set VX to VY?
-    chip->registers[x] = chip->registers[y];
+    // The VIP shifts VY, SCHIP shifts VX in place
+    if (quirks.shift_vy) chip->registers[x] = chip->registers[y];
 
     // Shift 1 bit to the right
     uint8_t original_vx = chip->registers[x];
@@ -468,10 +910,9 @@ void exec_8XY7(Chip8 *chip, uint8_t x, uint8_t y) {
     }
 }
 
-void exec_8XYE(Chip8 *chip, uint8_t x, uint8_t y) {
+SPECIALISED void exec_8XYE(Chip8 *chip, uint8_t x, uint8_t y, Quirks quirks) {
     debug(chip->debugger, halt_if_breakpoint(chip, "8XYE"));
-    // Set VX to VY?
-    chip->registers[x] = chip->registers[y];
+    if (quirks.shift_vy) chip->registers[x] = chip->registers[y];
 
     // Shift 1 bit to the left
     uint8_t original_vx = chip->registers[x];
@@ -485,7 +926,7 @@ void exec_9XY0(Chip8 *chip, uint8_t x, uint8_t y) {
     debug(chip->debugger, halt_if_breakpoint(chip, "9XY0"));
     
     if (chip->registers[x] != chip->registers[y]) {
-        chip->pc += 2;   
+        skip_instruction(chip);   
     }
 }
    
@@ -495,22 +936,51 @@ void exec_ANNN(Chip8 *chip, uint16_t nnn) {
     debug(chip->debugger, printf("IRegister: %X\n", chip->iregister));
 }
  
-void exec_BNNN(Chip8 *chip, uint16_t nnn) {
+SPECIALISED void exec_BNNN(Chip8 *chip, uint16_t nnn, Quirks quirks) {
     debug(chip->debugger, halt_if_breakpoint(chip, "BNNN"));
-    chip->pc = nnn + chip->registers[0];
+    // SCHIP reads the offset from VX, where X is the top nibble of the address
+    chip->pc = nnn + chip->registers[quirks.jump_vx ? nnn >> 8 : 0];
 }
  
 void exec_CXNN(Chip8 *chip, uint8_t x, uint8_t nn) {
     debug(chip->debugger, halt_if_breakpoint(chip, "CXNN"));
-    chip->registers[x] = rand() & nn;
+    // xorshift32
+    uint32_t random = chip->random_state;
+    random ^= random << 13;
+    random ^= random >> 17;
+    random ^= random << 5;
+    chip->random_state = random;
+
+    chip->registers[x] = random & nn;
 }
  
-void exec_DXYN(Chip8 *chip, uint8_t x, uint8_t y, uint8_t n) {
-    debug(chip->debugger, halt_if_breakpoint(chip, "DXYN"));
+// XOR a sprite row of sprite_width bits into a screen row at x, clipping or wrapping at the right edge.
+// Returns true if any pixel was turned off
+static inline __attribute__((always_inline)) bool draw_sprite_row(uint64_t *row, uint32_t sprite, int sprite_width,
+                                                                   int x, int width, bool clip) {
+    int word = x / ROW_WORD_BITS;
+    // Line the sprite up with the row word, if the shift is negative it spills into the next word
+    int shift = ROW_WORD_BITS - sprite_width - (x % ROW_WORD_BITS);
+    uint64_t bits = shift >= 0 ? (uint64_t) sprite << shift : (uint64_t) sprite >> -shift;
+    bool collision = (row[word] & bits) != 0;
+    row[word] ^= bits;
+
+    // The row is a whole number of words, so wrapping is just going back to the first one
+    int next = (word + 1) % (width / ROW_WORD_BITS);
+    if (shift < 0 && (!clip || next > word)) {
+        bits = (uint64_t) sprite << (ROW_WORD_BITS + shift);
+        collision |= (row[next] & bits) != 0;
+        row[next] ^= bits;
+    }
+
+    return collision;
+}
 
+static inline __attribute__((always_inline)) void draw_sprite(Chip8 *chip, uint8_t x, uint8_t y, int rows,
+                                                               int sprite_width, Quirks quirks) {
     // Halt Drawing until we hit the interrupt
     // This is pass the Display Quirk test in Timendus' test suite
-    if (!chip->display_interrupt_triggered) {
+    if (quirks.display_wait && !chip->display_interrupt_triggered) {
         chip->pc -= 2;
         return;
     } 
@@ -518,50 +988,62 @@ void exec_DXYN(Chip8 *chip, uint8_t x, uint8_t y, uint8_t n) {
     chip->display_interrupt_triggered = false; 
     
     // Get the X/Y coords to draw the sprite 
-    int x_coord = chip->registers[x] % SCREEN_WIDTH;
-    int y_coord = chip->registers[y] % SCREEN_HEIGHT;
+    int width = screen_width(chip);
+    int height = screen_height(chip);
+    int x_coord = chip->registers[x] % width;
+    int y_coord = chip->registers[y] % height;
+    int row_bytes = sprite_width / 8;
+    uint16_t address = chip->iregister;
 
     debug(chip->debugger, printf("x: %d, y: %d\n", x_coord, y_coord));
 
     // Premptively set VF to 0
     chip->registers[0xF] = 0;
 
-    for (int i = 0; i < n; i++) {
-        // Stop writing if we've hit the bottom
-        if (y_coord == SCREEN_HEIGHT) break; 
-        
-        uint8_t sprite = chip->memory[chip->iregister + i];
-        debug(chip->debugger, printf("Sprite at address %X: %X\n", chip->iregister + i, sprite));
-        int screen_idx = (y_coord * SCREEN_WIDTH) + x_coord;
-        debug(chip->debugger, printf("Screen Index: %d\n", screen_idx));
-
-        for (int j = 0; j < 8; j++) {
-            if (x_coord + j == SCREEN_WIDTH) { debug(chip->debugger, printf("Hit screen edge\n")); break; } 
-
-            if ((sprite & 128) == 128) {
-                if (chip->screen[screen_idx] == chip->foreground_colour) {
-                    chip->screen[screen_idx] = chip->background_colour;
-                    chip->registers[0xF] = 1;
-                } else {
-                    chip->screen[screen_idx] = chip->foreground_colour;
-                }
-            }
+    // Each selected plane takes its own copy of the sprite data, one after the other
+    for (int plane = 0; plane < NUM_OF_PLANES; plane++) {
+        if (!(chip->planes & (1 << plane))) continue;
+
+        for (int i = 0; i < rows; i++) {
+            // Stop writing if we've hit the bottom
+            if (quirks.clip && y_coord + i == height) break; 
+            int row = (y_coord + i) % height;
             
-            screen_idx++;
-            sprite = sprite<<1;
+            uint32_t row_address = address + i * row_bytes;
+            uint32_t sprite = read_memory(chip, row_address);
+            if (row_bytes == 2) {
+                sprite = (sprite << 8) | read_memory(chip, row_address + 1);
+            }
+            debug(chip->debugger, printf("Sprite at address %X: %X\n", row_address, sprite));
+
+            // Any pixel we turn off sets VF
+            if (draw_sprite_row(chip->screen[plane][row], sprite, sprite_width, x_coord, width, quirks.clip)) {
+                chip->registers[0xF] = 1;
+            }
         }
-        y_coord++;              
+
+        address += rows * row_bytes;
     }
 }
+ 
+SPECIALISED void exec_DXYN(Chip8 *chip, uint8_t x, uint8_t y, uint8_t n, Quirks quirks) {
+    debug(chip->debugger, halt_if_breakpoint(chip, "DXYN"));
+    draw_sprite(chip, x, y, n, 8, quirks);
+}
+
+SPECIALISED void exec_DXY0(Chip8 *chip, uint8_t x, uint8_t y, Quirks quirks) {
+    debug(chip->debugger, halt_if_breakpoint(chip, "DXY0"));
+    draw_sprite(chip, x, y, 16, 16, quirks);
+}
    
 void exec_EX9E(Chip8 *chip, uint8_t x) {
     debug(chip->debugger, halt_if_breakpoint(chip, "EX9E"));
 
     // x can only ever be 0-15
-    uint16_t key = (chip->keys_pressed>>chip->registers[x]) & 1;
+    uint16_t key = (chip->keys_pressed>>(chip->registers[x] & 0xF)) & 1;
     
     if (key) {
-        chip->pc += 2;   
+        skip_instruction(chip);   
     }
 }
 
@@ -569,10 +1051,10 @@ void exec_EXA1(Chip8 *chip, uint8_t x) {
     debug(chip->debugger, halt_if_breakpoint(chip, "EXA1"));
     
     // x can only ever be 0-15
-    uint16_t key = (chip->keys_pressed>>chip->registers[x]) & 1;
+    uint16_t key = (chip->keys_pressed>>(chip->registers[x] & 0xF)) & 1;
     
     if (!key) {
-        chip->pc += 2;   
+        skip_instruction(chip);   
     }
 }
 
@@ -628,17 +1110,19 @@ void exec_FX0A(Chip8 *chip, uint8_t x) {
         chip->registers[x] = pressed;
         // Set the snapshot to 0 to avoid weird state
         chip->keys_snapshot = 0;
+        chip->waiting_for_key = false;
     } else {
         // Decrement the PC to halt execution
         chip->pc -= 2;
+        chip->waiting_for_key = true;
     }
 }
 
 void exec_FX29(Chip8 *chip, uint8_t x) {
     debug(chip->debugger, halt_if_breakpoint(chip, "FX29"));
 
-    // We only want the first nibble
-    uint8_t font_char = x>>4;
+    // Only the low nibble of VX picks the character
+    uint8_t font_char = chip->registers[x] & 0xF;
 
     chip->iregister = FONT_START_MEMORY_ADDR + (font_char * 5);
 }
@@ -654,26 +1138,94 @@ void exec_FX33(Chip8 *chip, uint8_t x) {
     hundreds = (vx - tens - ones) / 100;
     
     uint16_t iregister = chip->iregister;
-    chip->memory[iregister] = hundreds;
-    chip->memory[iregister+1] = tens;
-    chip->memory[iregister+2] = ones;
+    write_memory(chip, iregister, hundreds);
+    write_memory(chip, iregister+1, tens);
+    write_memory(chip, iregister+2, ones);
 }
 
-void exec_FX55(Chip8 *chip, uint8_t x) {
+SPECIALISED void exec_FX55(Chip8 *chip, uint8_t x, Quirks quirks) {
     debug(chip->debugger, halt_if_breakpoint(chip, "FX55"));
 
     // <= as this opperation is inclusive
     for (int j = 0; j <= x; j++) {
-        chip->memory[chip->iregister] = chip->registers[j];   
-        chip->iregister++;
+        write_memory(chip, chip->iregister + j, chip->registers[j]);   
     }
+
+    if (quirks.memory_increment) chip->iregister += x + 1;
 }
 
-void exec_FX65(Chip8 *chip, uint8_t x) {
+SPECIALISED void exec_FX65(Chip8 *chip, uint8_t x, Quirks quirks) {
     debug(chip->debugger, halt_if_breakpoint(chip, "FX65"));
     // <= as this opperation is inclusive
     for (int j = 0; j <= x; j++) {
-        chip->registers[j] = chip->memory[chip->iregister];   
-        chip->iregister++;
+        chip->registers[j] = read_memory(chip, chip->iregister + j);   
     }
-}
\ No newline at end of file
+
+    if (quirks.memory_increment) chip->iregister += x + 1;
+}
+
+void exec_FX30(Chip8 *chip, uint8_t x) {
+    debug(chip->debugger, halt_if_breakpoint(chip, "FX30"));
+    chip->iregister = BIG_FONT_START_MEMORY_ADDR + (chip->registers[x] & 0xF) * 10;
+}
+
+void exec_FX75(Chip8 *chip, uint8_t x) {
+    debug(chip->debugger, halt_if_breakpoint(chip, "FX75"));
+    // SCHIP only has 8 flags
+    if (chip->mode == MODE_SCHIP && x >= SCHIP_NUM_OF_RPL_FLAGS) x = SCHIP_NUM_OF_RPL_FLAGS - 1;
+
+    memcpy(chip->rpl_flags, chip->registers, x + 1);
+}
+
+void exec_FX85(Chip8 *chip, uint8_t x) {
+    debug(chip->debugger, halt_if_breakpoint(chip, "FX85"));
+    if (chip->mode == MODE_SCHIP && x >= SCHIP_NUM_OF_RPL_FLAGS) x = SCHIP_NUM_OF_RPL_FLAGS - 1;
+
+    memcpy(chip->registers, chip->rpl_flags, x + 1);
+}
+
+void exec_5XY2(Chip8 *chip, uint8_t x, uint8_t y) {
+    debug(chip->debugger, halt_if_breakpoint(chip, "5XY2"));
+    // The range can run in either direction, I is left alone
+    int step = x <= y ? 1 : -1;
+    int count = (x <= y ? y - x : x - y) + 1;
+
+    for (int i = 0; i < count; i++) {
+        write_memory(chip, chip->iregister + i, chip->registers[x + i * step]);
+    }
+}
+
+void exec_5XY3(Chip8 *chip, uint8_t x, uint8_t y) {
+    debug(chip->debugger, halt_if_breakpoint(chip, "5XY3"));
+    int step = x <= y ? 1 : -1;
+    int count = (x <= y ? y - x : x - y) + 1;
+
+    for (int i = 0; i < count; i++) {
+        chip->registers[x + i * step] = read_memory(chip, chip->iregister + i);
+    }
+}
+
+void exec_F000(Chip8 *chip) {
+    debug(chip->debugger, halt_if_breakpoint(chip, "F000"));
+    // The address is the next word, which we then step over
+    chip->iregister = (read_memory(chip, chip->pc) << 8) | read_memory(chip, chip->pc + 1);
+    chip->pc += 2;
+}
+
+void exec_FN01(Chip8 *chip, uint8_t n) {
+    debug(chip->debugger, halt_if_breakpoint(chip, "FN01"));
+    chip->planes = n & ((1 << NUM_OF_PLANES) - 1);
+}
+
+void exec_F002(Chip8 *chip) {
+    debug(chip->debugger, halt_if_breakpoint(chip, "F002"));
+    for (int i = 0; i < AUDIO_PATTERN_SIZE; i++) {
+        chip->audio_pattern[i] = read_memory(chip, chip->iregister + i);
+    }
+    chip->audio_pattern_loaded = true;
+}
+
+void exec_FX3A(Chip8 *chip, uint8_t x) {
+    debug(chip->debugger, halt_if_breakpoint(chip, "FX3A"));
+    chip->pitch = chip->registers[x];
+}
@@ -5,10 +5,33 @@
 #include "consts.h"
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
+// Allocates a machine with enough memory for the mode, free it with cleanup_chip8
+Chip8 *create_chip8(Debugger *debug, uint8_t mode, uint8_t quirks, uint32_t foreground, uint32_t background);
+// Switch to another quirk profile's interpreter
+void set_quirks(Chip8 *chip, uint8_t quirks);
+// The quirks a profile stands for, for anything not using the specialised interpreters
+Quirks quirk_profile(uint8_t quirks);
+// Size of the whole machine including its memory
+size_t chip8_size(Chip8 const *chip);
 void init_chip8(Chip8 *chip, Debugger *debug, uint32_t foreground, uint32_t background);
 void cleanup_chip8(Chip8 *chip);
+// Both also fingerprint the ROM into rom_hash
 int load_rom(Chip8 *chip, char *rom_filename);
+// For reloading the same image over and over without touching the disk
+int load_rom_from_buffer(Chip8 *chip, uint8_t const *rom, size_t size);
+// Snapshot or restore a machine
+void copy_chip8(Chip8 *destination, Chip8 const *source);
+// Keep a copy of the machine as it is now, usually straight after load_rom. Free it with free()
+Chip8 *create_pristine_image(Chip8 *chip);
+// Put the machine back to its pristine image, only copying the memory pages written since
+void reset_chip8(Chip8 *chip, Chip8 const *pristine);
+// Tick the timers and the display interrupt at the start of each frame
+void start_frame(Chip8 *chip);
+// Run a whole frame at once, without the debugger or any pacing
+void run_frame(Chip8 *chip, uint64_t cycles_per_frame);
+// Run one instruction with the machine's quirk profile
 void cycle(Chip8 *chip);
 // Fetch and Decode the next instruction
 void decode(Chip8 *chip, Instruction *instruction);   
@@ -17,6 +40,13 @@ void update_timers(Chip8 *chip);
 // Instruction Implementations 
 void exec_00E0(Chip8 *chip);   
 void exec_00EE(Chip8 *chip);   
+void exec_00CN(Chip8 *chip, uint8_t n);
+void exec_00DN(Chip8 *chip, uint8_t n);
+void exec_00FB(Chip8 *chip);
+void exec_00FC(Chip8 *chip);
+void exec_00FD(Chip8 *chip);
+void exec_00FE(Chip8 *chip);
+void exec_00FF(Chip8 *chip);
 void exec_1NNN(Chip8 *chip, uint16_t nnn);   
 void exec_2NNN(Chip8 *chip, uint16_t nnn);   
 void exec_3XNN(Chip8 *chip, uint8_t x, uint8_t nn);   
@@ -25,19 +55,20 @@ void exec_5XY0(Chip8 *chip, uint8_t x, uint8_t y);
 void exec_6XNN(Chip8 *chip, uint8_t x, uint8_t nn);   
 void exec_7XNN(Chip8 *chip, uint8_t x, uint8_t nn);   
 void exec_8XY0(Chip8 *chip, uint8_t x, uint8_t y);
-void exec_8XY1(Chip8 *chip, uint8_t x, uint8_t y);
-void exec_8XY2(Chip8 *chip, uint8_t x, uint8_t y);
-void exec_8XY3(Chip8 *chip, uint8_t x, uint8_t y);
+void exec_8XY1(Chip8 *chip, uint8_t x, uint8_t y, Quirks quirks);
+void exec_8XY2(Chip8 *chip, uint8_t x, uint8_t y, Quirks quirks);
+void exec_8XY3(Chip8 *chip, uint8_t x, uint8_t y, Quirks quirks);
 void exec_8XY4(Chip8 *chip, uint8_t x, uint8_t y);
 void exec_8XY5(Chip8 *chip, uint8_t x, uint8_t y);
-void exec_8XY6(Chip8 *chip, uint8_t x, uint8_t y);
+void exec_8XY6(Chip8 *chip, uint8_t x, uint8_t y, Quirks quirks);
 void exec_8XY7(Chip8 *chip, uint8_t x, uint8_t y);
-void exec_8XYE(Chip8 *chip, uint8_t x, uint8_t y);
+void exec_8XYE(Chip8 *chip, uint8_t x, uint8_t y, Quirks quirks);
 void exec_9XY0(Chip8 *chip, uint8_t x, uint8_t y);   
 void exec_ANNN(Chip8 *chip, uint16_t nnn); 
-void exec_BNNN(Chip8 *chip, uint16_t nnn); 
+void exec_BNNN(Chip8 *chip, uint16_t nnn, Quirks quirks);
 void exec_CXNN(Chip8 *chip, uint8_t x, uint8_t nn); 
-void exec_DXYN(Chip8 *chip, uint8_t x, uint8_t y, uint8_t n);   
+void exec_DXYN(Chip8 *chip, uint8_t x, uint8_t y, uint8_t n, Quirks quirks);
+void exec_DXY0(Chip8 *chip, uint8_t x, uint8_t y, Quirks quirks);
 void exec_EX9E(Chip8 *chip, uint8_t x);
 void exec_EXA1(Chip8 *chip, uint8_t x);
 void exec_FX07(Chip8 *chip, uint8_t x);
@@ -47,6 +78,15 @@ void exec_FX1E(Chip8 *chip, uint8_t x);
 void exec_FX0A(Chip8 *chip, uint8_t x);
 void exec_FX29(Chip8 *chip, uint8_t x);
 void exec_FX33(Chip8 *chip, uint8_t x);
-void exec_FX55(Chip8 *chip, uint8_t x);
-void exec_FX65(Chip8 *chip, uint8_t x);
+void exec_FX55(Chip8 *chip, uint8_t x, Quirks quirks);
+void exec_FX65(Chip8 *chip, uint8_t x, Quirks quirks);
+void exec_FX30(Chip8 *chip, uint8_t x);
+void exec_FX75(Chip8 *chip, uint8_t x);
+void exec_FX85(Chip8 *chip, uint8_t x);
+void exec_5XY2(Chip8 *chip, uint8_t x, uint8_t y);
+void exec_5XY3(Chip8 *chip, uint8_t x, uint8_t y);
+void exec_F000(Chip8 *chip);
+void exec_FN01(Chip8 *chip, uint8_t n);
+void exec_F002(Chip8 *chip);
+void exec_FX3A(Chip8 *chip, uint8_t x);
 #endif
@@ -5,21 +5,35 @@
 #define SCREEN_WIDTH 64
 #define SCREEN_HEIGHT 32
 #define SCREEN_SIZE (SCREEN_WIDTH * SCREEN_HEIGHT)
+#define HIRES_SCREEN_WIDTH 128
+#define HIRES_SCREEN_HEIGHT 64
+#define ROW_WORD_BITS 64
+#define SCREEN_ROW_WORDS (HIRES_SCREEN_WIDTH / ROW_WORD_BITS)
+#define NUM_OF_PLANES 2
+#define NUM_OF_COLOURS (1 << NUM_OF_PLANES)
 #define DEFAULT_SCALE 10
 #define MINIMUM_SCALE 1
-#define PITCH 256
 
 // System constants
-#define NUM_OF_INSTRUCTIONS 34
+#define NUM_OF_INSTRUCTIONS 51
 #define NUM_OF_REGISTERS 16
+#define NUM_OF_RPL_FLAGS 16
+#define SCHIP_NUM_OF_RPL_FLAGS 8
 #define MAX_STACK_SIZE 16
 #define FONTSET_SIZE 80
 #define FONT_START_MEMORY_ADDR 0x50
+#define BIG_FONTSET_SIZE 160
+#define BIG_FONT_START_MEMORY_ADDR (FONT_START_MEMORY_ADDR + FONTSET_SIZE)
 #define ROM_START_MEMORY_ADDR 0x200 
+#define MEMORY_SIZE 4096
+#define XOCHIP_MEMORY_SIZE 65536
+// Memory is tracked in 64 pages so resets only restore what changed
+#define DIRTY_PAGE_SIZE (XOCHIP_MEMORY_SIZE / 64)
 #define NUM_OF_KEYS 16
 #define TARGET_FRAMES_PER_SECOND 60
 #define MICROSECS_IN_SECOND 1000000
 #define NANOSECS_IN_MICROSECONDS 1000
+#define NANOSECS_IN_SECOND 1000000000L
 
 // Colours 
 #define BLACK 0
@@ -39,10 +53,85 @@
 #define TURQUOISE 0x08F7FBFF
 #define WHITE 0xFFFFFFFF
 
+// Colours for pixels set in the second plane, or both planes (XO-CHIP)
+#define DEFAULT_PLANE_2_COLOUR ORANGE
+#define DEFAULT_OVERLAP_COLOUR SAGE
+
+// Modes, each one is a superset of the one before
+#define MODE_CHIP8 0
+#define MODE_SCHIP 1
+#define MODE_XOCHIP 2
+
+// Quirk Profiles
+#define QUIRKS_VIP 0
+#define QUIRKS_SCHIP 1
+#define QUIRKS_XO 2
+
 // Timing
 #define DEFAULT_TARGET_CYCLES_PER_SECOND 700
+#define MAXIMUM_RUN_AHEAD 8
+// Emulated frames per displayed frame while fast forwarding, uncapped runs as many as fit in a frame
+#define DEFAULT_TURBO 4
+#define MAXIMUM_TURBO 64
+#define TURBO_UNCAPPED 0
+
+// Audio
+#define AUDIO_SAMPLE_RATE 48000
+#define AUDIO_BUFFER_SAMPLES 256
+#define AUDIO_TONE_FREQUENCY 440
+#define AUDIO_VOLUME 0.25f
+#define AUDIO_EVENT_CAPACITY 64
+#define AUDIO_LATENCY_FRAMES 0.25
+#define AUDIO_MAX_DRIFT_FRAMES 1.5
+#define AUDIO_PATTERN_SIZE 16
+#define AUDIO_PATTERN_BITS (AUDIO_PATTERN_SIZE * 8)
+#define AUDIO_PATTERN_RATE 4000.0
+#define DEFAULT_PITCH 64
+
+// Stats, histogram buckets are split into 2^HISTOGRAM_SUB_BUCKET_BITS linear steps per power of two
+#define HISTOGRAM_SUB_BUCKET_BITS 4
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BUCKET_BITS)
+#define HISTOGRAM_BUCKETS ((64 - HISTOGRAM_SUB_BUCKET_BITS + 1) * HISTOGRAM_SUB_BUCKETS)
+
+// Tracing, each thread buffers this many events for the writer thread
+#define TRACE_EVENT_CAPACITY 16384
+#define TRACE_FLUSH_NANOSECONDS (NANOSECS_IN_SECOND / 10)
+
+// Shared memory frames, the magic reads "C8FB"
+#define SHARED_FRAME_MAGIC 0x42463843
+#define SHARED_FRAME_VERSION 1
+
+// Frame server, see server.h for the protocol
+#define SERVER_MAX_CLIENTS 8
+#define SERVER_OUTPUT_BUFFER_SIZE (64 * 1024)
+#define SERVER_KEYFRAME_INTERVAL 60
+#define SERVER_KEYFRAME 1
+#define SERVER_DELTA 2
+#define SERVER_KEY_PRESS 1
+#define SERVER_KEY_RELEASE 2
+#define SERVER_HEADER_SIZE 12
+#define SERVER_ROW_SIZE (2 + SCREEN_ROW_WORDS * 8)
+
+// Capture, frames waiting for the writer and encoded frames it can batch into one write
+#define CAPTURE_QUEUE_FRAMES 64
+#define CAPTURE_BUFFERS 4
+#define CAPTURE_MAX_FRAMES_PER_WRITE 32
+
+// Terminal display, terminals don't report key releases so keys are let go after this long without a repeat.
+// Auto repeat takes up to about 660ms to start, so until a key has repeated it gets longer
+#define TTY_KEY_HOLD_NANOSECONDS (NANOSECS_IN_SECOND / 5)
+#define TTY_KEY_FIRST_HOLD_NANOSECONDS (NANOSECS_IN_SECOND * 7 / 10)
+#define TTY_OUTPUT_BUFFER_SIZE (256 * 1024)
+
+// Scheduler, idle workers look for sessions to steal at least this often
+#define SCHEDULER_MAXIMUM_SLEEP (NANOSECS_IN_SECOND / 500)
+#define SCHEDULER_INITIAL_CAPACITY 64
+#define MAXIMUM_SESSIONS 1000000
+#define MAXIMUM_WORKERS 256
 
 // Keys
+#define KEY_EVENT_CAPACITY 64
+#define INPUT_BATCHES_PER_FRAME 4
 #define KEY_0_MASK 1
 #define KEY_1_MASK 2
 #define KEY_2_MASK 4
@@ -0,0 +1,83 @@
+#include "counters.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+static char const *COUNTER_NAMES[NUM_OF_COUNTERS] = {
+    [COUNTER_CYCLES] = "cycles",
+    [COUNTER_INSTRUCTIONS] = "instructions",
+    [COUNTER_BRANCH_MISSES] = "branch-misses",
+    [COUNTER_L1D_MISSES] = "L1d-misses",
+};
+
+#ifdef __linux__
+static int open_event(uint32_t type, uint64_t config) {
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    // Leaving the kernel out lets this work with perf_event_paranoid at 2
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+bool open_counters(Counters *counters) {
+    bool any = false;
+
+    for (int i = 0; i < NUM_OF_COUNTERS; i++) {
+        counters->fds[i] = -1;
+    }
+
+#ifdef __linux__
+    // Each counter is opened on its own so one the CPU lacks doesn't take the rest down with it
+    counters->fds[COUNTER_CYCLES] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    counters->fds[COUNTER_INSTRUCTIONS] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    counters->fds[COUNTER_BRANCH_MISSES] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    counters->fds[COUNTER_L1D_MISSES] = open_event(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+                                                   (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                                   (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+#endif
+
+    for (int i = 0; i < NUM_OF_COUNTERS; i++) {
+        any |= counters->fds[i] >= 0;
+    }
+
+    return any;
+}
+
+bool counter_available(Counters const *counters, Counter counter) {
+    return counters->fds[counter] >= 0;
+}
+
+void read_counters(Counters const *counters, uint64_t values[NUM_OF_COUNTERS]) {
+    for (int i = 0; i < NUM_OF_COUNTERS; i++) {
+        values[i] = 0;
+        if (counters->fds[i] >= 0 && read(counters->fds[i], &values[i], sizeof(values[i])) != sizeof(values[i])) {
+            values[i] = 0;
+        }
+    }
+}
+
+char const *counter_name(Counter counter) {
+    return COUNTER_NAMES[counter];
+}
+
+void close_counters(Counters *counters) {
+    for (int i = 0; i < NUM_OF_COUNTERS; i++) {
+        if (counters->fds[i] >= 0) {
+            close(counters->fds[i]);
+        }
+        counters->fds[i] = -1;
+    }
+}
@@ -0,0 +1,29 @@
+#ifndef COUNTERS_H_
+#define COUNTERS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Hardware performance counters for this thread, counting user space only
+typedef enum {
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_BRANCH_MISSES,
+    COUNTER_L1D_MISSES,
+    NUM_OF_COUNTERS
+} Counter;
+
+typedef struct {
+    // -1 where the counter couldn't be opened
+    int fds[NUM_OF_COUNTERS];
+} Counters;
+
+// Returns false if none of the counters are available, e.g. in a container or off Linux
+bool open_counters(Counters *counters);
+bool counter_available(Counters const *counters, Counter counter);
+// Current totals, unavailable counters read as 0. Subtract two reads to count a region
+void read_counters(Counters const *counters, uint64_t values[NUM_OF_COUNTERS]);
+char const *counter_name(Counter counter);
+void close_counters(Counters *counters);
+
+#endif
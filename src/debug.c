@@ -52,6 +52,23 @@ void init_debugger(Debugger *debugger) {
     strcpy(debugger->instruction_map[31], "FX33\0");
     strcpy(debugger->instruction_map[32], "FX55\0");
     strcpy(debugger->instruction_map[33], "FX65\0");
+    strcpy(debugger->instruction_map[34], "00CN\0");
+    strcpy(debugger->instruction_map[35], "00FB\0");
+    strcpy(debugger->instruction_map[36], "00FC\0");
+    strcpy(debugger->instruction_map[37], "00FD\0");
+    strcpy(debugger->instruction_map[38], "00FE\0");
+    strcpy(debugger->instruction_map[39], "00FF\0");
+    strcpy(debugger->instruction_map[40], "DXY0\0");
+    strcpy(debugger->instruction_map[41], "FX30\0");
+    strcpy(debugger->instruction_map[42], "FX75\0");
+    strcpy(debugger->instruction_map[43], "FX85\0");
+    strcpy(debugger->instruction_map[44], "00DN\0");
+    strcpy(debugger->instruction_map[45], "5XY2\0");
+    strcpy(debugger->instruction_map[46], "5XY3\0");
+    strcpy(debugger->instruction_map[47], "F000\0");
+    strcpy(debugger->instruction_map[48], "FN01\0");
+    strcpy(debugger->instruction_map[49], "F002\0");
+    strcpy(debugger->instruction_map[50], "FX3A\0");
 }
 
 void cleanup_debugger(Debugger *debugger) {
@@ -79,20 +96,21 @@ int debug_prompt_user(Debugger *debugger, Chip8 *chip) {
             case 'b':
                 // We want to loop regardless
                 valid = false;
-                printf("1.  00E0 Clear    11. 8XY1 BIN OR   21. BNNN Jump OFF  31. FX29 Font Char \n");
-                printf("2.  00EE Return   12. 8XY2 BIN AND  22. CXNN Random    32. FX33 Decimal\n");
-                printf("3.  1NNN Jump     13. 8XY3 LOG XOR  23. DXYN Display   33. FX55 Store\n");
-                printf("4.  2NNN Sub      14. 8XY4 ADD XY   24. EX9E Skip Key  34. FX65 Load\n");
-                printf("5.  3XNN Skip=    15. 8XY5 SUB XY   25. EXA1 Skip !Key\n");
-                printf("6.  4XNN Skip!=   16. 8XY6 RSHIFT   26. FX07 X = Delay\n");
-                printf("7.  5XY0 Skipx=y  17. 8XY7 SUB YX   27. FX15 Delay\n");
-                printf("8.  6XNN Set NN   18. 8XYE LSHIFT   28. FX18 Sound\n");
-                printf("9.  7XNN Add NN   19. 9XY0 Skipx!=y 29. FX1E IDX + X\n");
-                printf("10. 8XY0 Set x=y  20. ANNN Set IDX  30. FX0A Get Key\n");
+                printf("1.  00E0 Clear    11. 8XY1 BIN OR   21. BNNN Jump OFF  31. FX29 Font Char  41. DXY0 Display16\n");
+                printf("2.  00EE Return   12. 8XY2 BIN AND  22. CXNN Random    32. FX33 Decimal    42. FX30 Big Font\n");
+                printf("3.  1NNN Jump     13. 8XY3 LOG XOR  23. DXYN Display   33. FX55 Store      43. FX75 Save RPL\n");
+                printf("4.  2NNN Sub      14. 8XY4 ADD XY   24. EX9E Skip Key  34. FX65 Load       44. FX85 Load RPL\n");
+                printf("5.  3XNN Skip=    15. 8XY5 SUB XY   25. EXA1 Skip !Key 35. 00CN Scroll D   45. 00DN Scroll U\n");
+                printf("6.  4XNN Skip!=   16. 8XY6 RSHIFT   26. FX07 X = Delay 36. 00FB Scroll R   46. 5XY2 Store XY\n");
+                printf("7.  5XY0 Skipx=y  17. 8XY7 SUB YX   27. FX15 Delay     37. 00FC Scroll L   47. 5XY3 Load XY\n");
+                printf("8.  6XNN Set NN   18. 8XYE LSHIFT   28. FX18 Sound     38. 00FD Exit       48. F000 Long IDX\n");
+                printf("9.  7XNN Add NN   19. 9XY0 Skipx!=y 29. FX1E IDX + X   39. 00FE Lores      49. FN01 Planes\n");
+                printf("10. 8XY0 Set x=y  20. ANNN Set IDX  30. FX0A Get Key   40. 00FF Hires      50. F002 Pattern\n");
+                printf("                                                                           51. FX3A Pitch\n");
                 printf("Please select an instruction: ");
                 
                 int selection = read_user_integer_input();                
-                if (selection < 1 || selection > 34) {
+                if (selection < 1 || selection > NUM_OF_INSTRUCTIONS) {
                     printf("Invalid input\n");
                 } else {
                     if (debugger->breakpoints[selection-1]) {
@@ -205,10 +223,12 @@ void set_key_state(Chip8 *chip) {
                 break;
             }
 
-            if (!register_key_press(chip, key)) {
+            uint16_t mask = map_key(key);
+            if (mask == 0) {
                 printf("Invalid input\n");
                 continue;
             }
+            chip->keys_pressed ^= mask;
 
             valid = true;
         }
@@ -0,0 +1,235 @@
+#include "dispatch.h"
+#include "chip8.h"
+#include "consts.h"
+#include "debug.h"
+#include "structs.h"
+#include <stdint.h>
+#include <stdio.h>
+
+typedef void (*Operation)(Chip8 *chip, Instruction const *instruction, Quirks const *quirks);
+
+static void undefined(Chip8 *chip, Instruction const *in, Quirks const *quirks) {
+    printf("UNDEFINED INSTRUCTION %X%X%X%X\n", in->instruction, in->x, in->y, in->n);
+}
+
+static void skipped(Chip8 *chip, Instruction const *in, Quirks const *quirks) {
+    printf("Skipping 0%X%X%X instruction\n", in->x, in->y, in->n);
+}
+
+// 0NNN, the SCHIP and XO-CHIP screen instructions live here
+static void op_0(Chip8 *chip, Instruction const *in, Quirks const *quirks) {
+    bool schip = chip->mode >= MODE_SCHIP;
+
+    if (in->nnn == 0x0E0) {
+        exec_00E0(chip);
+    } else if (in->nnn == 0x0EE) {
+        exec_00EE(chip);
+    } else if (in->nnn == 0x0FB && schip) {
+        exec_00FB(chip);
+    } else if (in->nnn == 0x0FC && schip) {
+        exec_00FC(chip);
+    } else if (in->nnn == 0x0FD && schip) {
+        exec_00FD(chip);
+    } else if (in->nnn == 0x0FE && schip) {
+        exec_00FE(chip);
+    } else if (in->nnn == 0x0FF && schip) {
+        exec_00FF(chip);
+    } else if (in->x == 0 && in->y == 0xC && schip) {
+        exec_00CN(chip, in->n);
+    } else if (in->x == 0 && in->y == 0xD && chip->mode >= MODE_XOCHIP) {
+        exec_00DN(chip, in->n);
+    } else {
+        skipped(chip, in, quirks);
+    }
+}
+
+static void op_1(Chip8 *chip, Instruction const *in, Quirks const *quirks) {
+    exec_1NNN(chip, in->nnn);
+}
+
+static void op_2(Chip8 *chip, Instruction const *in, Quirks const *quirks) {
+    exec_2NNN(chip, in->nnn);
+}
+
+static void op_3(Chip8 *chip, Instruction const *in, Quirks const *quirks) {
+    exec_3XNN(chip, in->x, in->nn);
+}
+
+static void op_4(Chip8 *chip, Instruction const *in, Quirks const *quirks) {
+    exec_4XNN(chip, in->x, in->nn);
+}
+
+static void op_5(Chip8 *chip, Instruction const *in, Quirks const *quirks) {
+    if (in->n == 0) {
+        exec_5XY0(chip, in->x, in->y);
+    } else if (in->n == 2 && chip->mode >= MODE_XOCHIP) {
+        exec_5XY2(chip, in->x, in->y);
+    } else if (in->n == 3 && chip->mode >= MODE_XOCHIP) {
+        exec_5XY3(chip, in->x, in->y);
+    } else {
+        undefined(chip, in, quirks);
+    }
+}
+
+static void op_6(Chip8 *chip, Instruction const *in, Quirks const *quirks) {
+    exec_6XNN(chip, in->x, in->nn);
+}
+
+static void op_7(Chip8 *chip, Instruction const *in, Quirks const *quirks) {
+    exec_7XNN(chip, in->x, in->nn);
+}
+
+static void op_8XY0(Chip8 *chip, Instruction const *in, Quirks const *quirks) { exec_8XY0(chip, in->x, in->y); }
+static void op_8XY1(Chip8 *chip, Instruction const *in, Quirks const *quirks) { exec_8XY1(chip, in->x, in->y, *quirks); }
+static void op_8XY2(Chip8 *chip, Instruction const *in, Quirks const *quirks) { exec_8XY2(chip, in->x, in->y, *quirks); }
+static void op_8XY3(Chip8 *chip, Instruction const *in, Quirks const *quirks) { exec_8XY3(chip, in->x, in->y, *quirks); }
+static void op_8XY4(Chip8 *chip, Instruction const *in, Quirks const *quirks) { exec_8XY4(chip, in->x, in->y); }
+static void op_8XY5(Chip8 *chip, Instruction const *in, Quirks const *quirks) { exec_8XY5(chip, in->x, in->y); }
+static void op_8XY6(Chip8 *chip, Instruction const *in, Quirks const *quirks) { exec_8XY6(chip, in->x, in->y, *quirks); }
+static void op_8XY7(Chip8 *chip, Instruction const *in, Quirks const *quirks) { exec_8XY7(chip, in->x, in->y); }
+static void op_8XYE(Chip8 *chip, Instruction const *in, Quirks const *quirks) { exec_8XYE(chip, in->x, in->y, *quirks); }
+
+// Indexed by N
+static Operation const ARITHMETIC[16] = {
+    op_8XY0, op_8XY1, op_8XY2, op_8XY3, op_8XY4, op_8XY5, op_8XY6, op_8XY7,
+    undefined, undefined, undefined, undefined, undefined, undefined, op_8XYE, undefined
+};
+
+static void op_8(Chip8 *chip, Instruction const *in, Quirks const *quirks) {
+    ARITHMETIC[in->n](chip, in, quirks);
+}
+
+static void op_9(Chip8 *chip, Instruction const *in, Quirks const *quirks) {
+    if (in->n == 0) {
+        exec_9XY0(chip, in->x, in->y);
+    } else {
+        undefined(chip, in, quirks);
+    }
+}
+
+static void op_A(Chip8 *chip, Instruction const *in, Quirks const *quirks) {
+    exec_ANNN(chip, in->nnn);
+}
+
+static void op_B(Chip8 *chip, Instruction const *in, Quirks const *quirks) {
+    exec_BNNN(chip, in->nnn, *quirks);
+}
+
+static void op_C(Chip8 *chip, Instruction const *in, Quirks const *quirks) {
+    exec_CXNN(chip, in->x, in->nn);
+}
+
+static void op_D(Chip8 *chip, Instruction const *in, Quirks const *quirks) {
+    if (in->n == 0 && chip->mode >= MODE_SCHIP) {
+        exec_DXY0(chip, in->x, in->y, *quirks);
+    } else {
+        exec_DXYN(chip, in->x, in->y, in->n, *quirks);
+    }
+    chip->waiting_to_draw++;
+}
+
+static void op_E(Chip8 *chip, Instruction const *in, Quirks const *quirks) {
+    if (in->nn == 0x9E) {
+        exec_EX9E(chip, in->x);
+    } else if (in->nn == 0xA1) {
+        exec_EXA1(chip, in->x);
+    } else {
+        undefined(chip, in, quirks);
+    }
+}
+
+static void op_F000(Chip8 *chip, Instruction const *in, Quirks const *quirks) {
+    if (in->x == 0 && chip->mode >= MODE_XOCHIP) {
+        exec_F000(chip);
+    } else {
+        undefined(chip, in, quirks);
+    }
+}
+
+static void op_FN01(Chip8 *chip, Instruction const *in, Quirks const *quirks) {
+    if (chip->mode >= MODE_XOCHIP) {
+        exec_FN01(chip, in->x);
+    } else {
+        undefined(chip, in, quirks);
+    }
+}
+
+static void op_F002(Chip8 *chip, Instruction const *in, Quirks const *quirks) {
+    if (in->x == 0 && chip->mode >= MODE_XOCHIP) {
+        exec_F002(chip);
+    } else {
+        undefined(chip, in, quirks);
+    }
+}
+
+static void op_FX3A(Chip8 *chip, Instruction const *in, Quirks const *quirks) {
+    if (chip->mode >= MODE_XOCHIP) {
+        exec_FX3A(chip, in->x);
+    } else {
+        undefined(chip, in, quirks);
+    }
+}
+
+static void op_FX30(Chip8 *chip, Instruction const *in, Quirks const *quirks) {
+    if (chip->mode >= MODE_SCHIP) {
+        exec_FX30(chip, in->x);
+    } else {
+        undefined(chip, in, quirks);
+    }
+}
+
+static void op_FX75(Chip8 *chip, Instruction const *in, Quirks const *quirks) {
+    if (chip->mode >= MODE_SCHIP) {
+        exec_FX75(chip, in->x);
+    } else {
+        undefined(chip, in, quirks);
+    }
+}
+
+static void op_FX85(Chip8 *chip, Instruction const *in, Quirks const *quirks) {
+    if (chip->mode >= MODE_SCHIP) {
+        exec_FX85(chip, in->x);
+    } else {
+        undefined(chip, in, quirks);
+    }
+}
+
+static void op_FX07(Chip8 *chip, Instruction const *in, Quirks const *quirks) { exec_FX07(chip, in->x); }
+static void op_FX0A(Chip8 *chip, Instruction const *in, Quirks const *quirks) { exec_FX0A(chip, in->x); }
+static void op_FX15(Chip8 *chip, Instruction const *in, Quirks const *quirks) { exec_FX15(chip, in->x); }
+static void op_FX18(Chip8 *chip, Instruction const *in, Quirks const *quirks) { exec_FX18(chip, in->x); }
+static void op_FX1E(Chip8 *chip, Instruction const *in, Quirks const *quirks) { exec_FX1E(chip, in->x); }
+static void op_FX29(Chip8 *chip, Instruction const *in, Quirks const *quirks) { exec_FX29(chip, in->x); }
+static void op_FX33(Chip8 *chip, Instruction const *in, Quirks const *quirks) { exec_FX33(chip, in->x); }
+static void op_FX55(Chip8 *chip, Instruction const *in, Quirks const *quirks) { exec_FX55(chip, in->x, *quirks); }
+static void op_FX65(Chip8 *chip, Instruction const *in, Quirks const *quirks) { exec_FX65(chip, in->x, *quirks); }
+
+// Indexed by NN, anything missing is undefined
+static Operation const MISCELLANEOUS[256] = {
+    [0x00] = op_F000, [0x01] = op_FN01, [0x02] = op_F002, [0x07] = op_FX07,
+    [0x0A] = op_FX0A, [0x15] = op_FX15, [0x18] = op_FX18, [0x1E] = op_FX1E,
+    [0x29] = op_FX29, [0x30] = op_FX30, [0x33] = op_FX33, [0x3A] = op_FX3A,
+    [0x55] = op_FX55, [0x65] = op_FX65, [0x75] = op_FX75, [0x85] = op_FX85
+};
+
+static void op_F(Chip8 *chip, Instruction const *in, Quirks const *quirks) {
+    Operation operation = MISCELLANEOUS[in->nn];
+    (operation != NULL ? operation : undefined)(chip, in, quirks);
+}
+
+// Indexed by the top nibble
+static Operation const OPERATIONS[16] = {
+    op_0, op_1, op_2, op_3, op_4, op_5, op_6, op_7,
+    op_8, op_9, op_A, op_B, op_C, op_D, op_E, op_F
+};
+
+void cycle_table(Chip8 *chip) {
+    Instruction instruction = { 0 };
+    Quirks quirks = quirk_profile(chip->quirks);
+
+    decode(chip, &instruction);
+
+    debug(chip->debugger, debug_instruction(&instruction));
+
+    OPERATIONS[instruction.instruction](chip, &instruction, &quirks);
+}
@@ -0,0 +1,10 @@
+#ifndef DISPATCH_H_
+#define DISPATCH_H_
+
+#include "structs.h"
+
+// Table driven interpreter, an independent second implementation of cycle().
+// It reads the quirks at run time, so it's mainly here to check engines against each other
+void cycle_table(Chip8 *chip);
+
+#endif
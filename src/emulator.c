@@ -0,0 +1,297 @@
+#include "emulator.h"
+#include "audio.h"
+#include "capture.h"
+#include "chip8.h"
+#include "consts.h"
+#include "debug.h"
+#include "frame.h"
+#include "ring.h"
+#include "shm.h"
+#include "stats.h"
+#include "structs.h"
+#include "timing.h"
+#include "trace.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void apply_key_events(Emulator *emulator) {
+    Chip8 *chip = emulator->chip;
+    KeyEvent event;
+
+    while (ring_pop(&emulator->key_events, &event)) {
+        if (emulator->pending_inputs < KEY_EVENT_CAPACITY) {
+            emulator->input_timestamps[emulator->pending_inputs++] = event.timestamp;
+        }
+
+        if (event.pressed) {
+            chip->keys_pressed |= event.mask;
+        } else {
+            chip->keys_pressed &= ~event.mask;
+        }
+    }
+
+    // Only keys the consumer changed are applied, so it can't release keys held on the keyboard
+    if (emulator->shared != NULL) {
+        uint16_t keys = shared_keys(emulator->shared);
+        uint16_t changed = keys ^ emulator->shared_keys;
+
+        chip->keys_pressed = (chip->keys_pressed & ~changed) | (keys & changed);
+        emulator->shared_keys = keys;
+    }
+}
+
+static bool run_cycles(Emulator *emulator, uint64_t cycles) {
+    Chip8 *chip = emulator->chip;
+
+    for (int i = 0; i < cycles; i++) {
+        if (chip->debugger != NULL) {
+            bool quit = chip->debugger->exit;
+            if (!quit && chip->debugger->stepping) {
+                quit = debug_prompt_user(chip->debugger, chip);
+            }
+
+            // Prevent execution of instruction when we quit the debugger
+            if (quit) {
+                atomic_store(&emulator->quit, true);
+                return false;
+            }
+        }
+        cycle(chip);
+    }
+
+    return true;
+}
+
+// The next instruction is a draw that has to wait for the display interrupt
+static bool waiting_for_display(Chip8 const *chip) {
+    uint8_t high = chip->memory[chip->pc & (chip->memory_size - 1)];
+    return quirk_profile(chip->quirks).display_wait && !chip->display_interrupt_triggered && (high >> 4) == 0xD;
+}
+
+// Runs one frame split into batches spread across the frame, so input that
+// arrives mid frame is seen by the program before the frame is presented.
+// Fast forwarded frames run their batches back to back.
+// Returns how long was spent running cycles
+static uint64_t emulate_frame(Emulator *emulator, uint64_t frame_start, bool paced) {
+    Chip8 *chip = emulator->chip;
+    uint64_t delay = NANOSECS_IN_SECOND / TARGET_FRAMES_PER_SECOND;
+    uint64_t done = 0;
+    uint64_t busy = 0;
+
+    uint64_t start = now_nanoseconds();
+    start_frame(chip);
+    uint64_t end = now_nanoseconds();
+    trace_event(emulator->tracer, TRACE_EMULATION_THREAD, TRACE_TIMERS, start, end);
+
+    // The display interrupt has just released any draw that was waiting
+    if (emulator->display_wait_start != 0) {
+        trace_event(emulator->tracer, TRACE_EMULATION_THREAD, TRACE_DISPLAY_WAIT, emulator->display_wait_start, end);
+        emulator->display_wait_start = 0;
+    }
+
+    for (int batch = 1; batch <= INPUT_BATCHES_PER_FRAME; batch++) {
+        apply_key_events(emulator);
+
+        uint64_t target = emulator->cycles_per_frame * batch / INPUT_BATCHES_PER_FRAME;
+        start = now_nanoseconds();
+        bool running = run_cycles(emulator, target - done);
+        end = now_nanoseconds();
+        busy += end - start;
+        trace_event(emulator->tracer, TRACE_EMULATION_THREAD, TRACE_CYCLES, start, end);
+        if (!running) break;
+        done = target;
+
+        // Only noticed at the end of a batch, so waits are timed from there
+        if (emulator->tracer != NULL && emulator->display_wait_start == 0 && waiting_for_display(chip)) {
+            emulator->display_wait_start = end;
+        }
+
+        if (paced && batch < INPUT_BATCHES_PER_FRAME) {
+            sleep_until_nanoseconds(frame_start + delay * batch / INPUT_BATCHES_PER_FRAME);
+        }
+    }
+
+    atomic_fetch_add_explicit(&emulator->stats.cycles, done, memory_order_relaxed);
+    atomic_fetch_add_explicit(&emulator->stats.frames, 1, memory_order_relaxed);
+    return busy;
+}
+
+// Every key event applied this frame is now visible
+static void record_input_latency(Emulator *emulator) {
+    uint64_t now = now_nanoseconds();
+
+    for (uint32_t i = 0; i < emulator->pending_inputs; i++) {
+        record_value(&emulator->stats.input_latency, now - emulator->input_timestamps[i]);
+    }
+    emulator->pending_inputs = 0;
+}
+
+static void publish_screen(Emulator *emulator, Chip8 const *chip, uint64_t number) {
+    Frame *frame = frame_for_writing(&emulator->frames);
+
+    fill_frame(frame, chip, number);
+
+    if (emulator->shared != NULL) {
+        publish_shared_frame(emulator->shared, frame);
+    }
+
+    publish_frame(&emulator->frames);
+}
+
+// Play the next few frames on a copy of the machine with the current input and show
+// the result, the real machine carries on from where it was so nothing needs restoring
+static Chip8 const *play_ahead(Emulator *emulator) {
+    if (emulator->run_ahead == 0) {
+        return emulator->chip;
+    }
+
+    copy_chip8(emulator->ahead, emulator->chip);
+    // The debugger only follows the real machine
+    emulator->ahead->debugger = NULL;
+
+    for (uint32_t i = 0; i < emulator->run_ahead; i++) {
+        run_frame(emulator->ahead, emulator->cycles_per_frame);
+    }
+
+    return emulator->ahead;
+}
+
+// The capture gets every emulated frame of the real machine, including ones fast forwarded past
+// without being shown. Run-ahead frames are guesses for the display and are never recorded
+static void capture_machine(Emulator *emulator, uint64_t number) {
+    if (emulator->capture == NULL) {
+        return;
+    }
+
+    fill_frame(&emulator->captured, emulator->chip, number);
+    capture_frame(emulator->capture, &emulator->captured);
+}
+
+static bool buzzer_changed(BuzzerEvent const *last, BuzzerEvent const *next) {
+    if (last->on != next->on || last->patterned != next->patterned) return true;
+    if (!next->patterned) return false;
+
+    return last->pitch != next->pitch || memcmp(last->pattern, next->pattern, sizeof(next->pattern)) != 0;
+}
+
+static void *emulation_thread(void *arg) {
+    Emulator *emulator = arg;
+    Chip8 *chip = emulator->chip;
+    BuzzerEvent last_buzzer = { 0 };
+    // Counts displayed frames, so dropped frames and the audio clock follow the wall clock while fast forwarding
+    uint64_t frame_number = 0;
+    uint64_t emulated_frames = 0;
+    uint64_t delay = NANOSECS_IN_SECOND / TARGET_FRAMES_PER_SECOND;
+    uint64_t next = now_nanoseconds();
+
+    while (!atomic_load_explicit(&emulator->quit, memory_order_relaxed)) {
+        bool fast_forward = atomic_load_explicit(&emulator->fast_forward, memory_order_relaxed);
+        uint64_t busy = 0;
+
+        // Fast forwarding only shows the last of each displayed frame's emulated frames, uncapped
+        // runs them until the displayed frame is due
+        if (!fast_forward) {
+            busy = emulate_frame(emulator, next, true);
+            capture_machine(emulator, ++emulated_frames);
+        } else {
+            uint32_t frames = emulator->turbo == TURBO_UNCAPPED ? UINT32_MAX : emulator->turbo;
+
+            for (uint32_t i = 0; i < frames && !atomic_load(&emulator->quit); i++) {
+                busy += emulate_frame(emulator, next, false);
+                capture_machine(emulator, ++emulated_frames);
+                if (emulator->turbo == TURBO_UNCAPPED && now_nanoseconds() >= next + delay) break;
+            }
+        }
+
+        uint64_t start = now_nanoseconds();
+        Chip8 const *shown = play_ahead(emulator);
+        busy += now_nanoseconds() - start;
+
+        publish_screen(emulator, shown, ++frame_number);
+        record_input_latency(emulator);
+        record_value(&emulator->stats.emulation, busy);
+
+        // Tell the audio callback about buzzer changes, if the queue is full we retry next frame
+        if (emulator->audio != NULL) {
+            BuzzerEvent buzzer = { frame_number, chip->sound_timer > 0, chip->audio_pattern_loaded, chip->pitch };
+            memcpy(buzzer.pattern, chip->audio_pattern, sizeof(buzzer.pattern));
+
+            if (buzzer_changed(&last_buzzer, &buzzer) && queue_buzzer(emulator->audio, &buzzer)) {
+                last_buzzer = buzzer;
+            }
+            advance_audio_clock(emulator->audio, frame_number);
+        }
+
+        // If we've fallen more than a frame behind (e.g. sitting in the debugger) don't try to catch up.
+        // A turbo setting too fast for the host lowers the display rate instead
+        next += delay;
+        uint64_t now = now_nanoseconds();
+        if (now > next + delay) {
+            atomic_fetch_add_explicit(&emulator->stats.late_frames, (now - next) / delay, memory_order_relaxed);
+            next = now;
+        }
+
+        sleep_until_nanoseconds(next);
+    }
+
+    return NULL;
+}
+
+bool start_emulator(Emulator *emulator, Chip8 *chip, uint64_t cycles_per_frame, uint32_t run_ahead, uint32_t turbo,
+                    bool fast_forward, Audio *audio, Tracer *tracer, SharedFrame *shared, Capture *capture) {
+    emulator->chip = chip;
+    emulator->cycles_per_frame = cycles_per_frame;
+    emulator->run_ahead = run_ahead;
+    emulator->turbo = turbo;
+    atomic_init(&emulator->fast_forward, fast_forward);
+    emulator->audio = audio;
+    emulator->tracer = tracer;
+    emulator->shared = shared;
+    emulator->shared_keys = 0;
+    emulator->capture = capture;
+    emulator->display_wait_start = 0;
+    emulator->pending_inputs = 0;
+    init_triple_buffer(&emulator->frames);
+    init_stats(&emulator->stats);
+    atomic_init(&emulator->quit, false);
+
+    if (!init_ring_buffer(&emulator->key_events, KEY_EVENT_CAPACITY, sizeof(KeyEvent))) {
+        printf("Failed to allocate key event queue\n");
+        return false;
+    }
+
+    emulator->ahead = NULL;
+    if (run_ahead > 0) {
+        emulator->ahead = malloc(chip8_size(chip));
+        if (emulator->ahead == NULL) {
+            printf("Failed to allocate run ahead machine\n");
+            cleanup_ring_buffer(&emulator->key_events);
+            return false;
+        }
+    }
+
+    // Make sure there is something to show before the first frame finishes
+    publish_screen(emulator, chip, 0);
+
+    if (pthread_create(&emulator->thread, NULL, emulation_thread, emulator) != 0) {
+        printf("Failed to start emulation thread\n");
+        cleanup_ring_buffer(&emulator->key_events);
+        free(emulator->ahead);
+        return false;
+    }
+
+    return true;
+}
+
+void stop_emulator(Emulator *emulator) {
+    atomic_store(&emulator->quit, true);
+    pthread_join(emulator->thread, NULL);
+    cleanup_ring_buffer(&emulator->key_events);
+    free(emulator->ahead);
+    emulator->ahead = NULL;
+}
@@ -0,0 +1,62 @@
+#ifndef EMULATOR_H_
+#define EMULATOR_H_
+
+#include "audio.h"
+#include "capture.h"
+#include "frame.h"
+#include "ring.h"
+#include "shm.h"
+#include "stats.h"
+#include "trace.h"
+#include "structs.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Runs a Chip8 on its own thread so presenting never steals time from emulation
+typedef struct {
+    Chip8 *chip;
+    uint64_t cycles_per_frame;
+    // Frames to run ahead of the real machine before presenting, 0 to disable
+    uint32_t run_ahead;
+    // Emulated frames per displayed frame while fast forwarding, TURBO_UNCAPPED for as many as fit
+    uint32_t turbo;
+    // Flipped by the fast forward hotkey
+    _Atomic bool fast_forward;
+    // Scratch copy of the machine the run ahead frames are played on
+    Chip8 *ahead;
+    pthread_t thread;
+    // Buzzer output, NULL if audio is unavailable
+    Audio *audio;
+    // Frame phase events, NULL unless tracing
+    Tracer *tracer;
+    // Frames published to and keys read from other processes, NULL unless sharing
+    SharedFrame *shared;
+    // Keys the shared memory consumer was holding last time we looked
+    uint16_t shared_keys;
+    // Gets a copy of every frame, NULL unless capturing
+    Capture *capture;
+    // Every frame of the real machine goes to the capture through here
+    Frame captured;
+    // When the program started waiting on a draw for the display interrupt, 0 if it isn't
+    uint64_t display_wait_start;
+
+    // Finished frames going to the render thread
+    TripleBuffer frames;
+    // KeyEvents coming from the render thread
+    RingBuffer key_events;
+    // When each key event applied this frame was seen by the host, for the input latency
+    uint64_t input_timestamps[KEY_EVENT_CAPACITY];
+    uint32_t pending_inputs;
+    // Read by any thread while the emulation runs
+    Stats stats;
+    // Set by either thread to shut both down
+    _Atomic bool quit;
+} Emulator;
+
+bool start_emulator(Emulator *emulator, Chip8 *chip, uint64_t cycles_per_frame, uint32_t run_ahead, uint32_t turbo,
+                    bool fast_forward, Audio *audio, Tracer *tracer, SharedFrame *shared, Capture *capture);
+void stop_emulator(Emulator *emulator);
+
+#endif
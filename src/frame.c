@@ -0,0 +1,48 @@
+#include "frame.h"
+#include "consts.h"
+#include "structs.h"
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+
+#define FRAME_FRESH 0x80
+#define FRAME_INDEX_MASK 0x3
+
+void init_triple_buffer(TripleBuffer *buffer) {
+    memset(buffer->frames, 0, sizeof(buffer->frames));
+    buffer->writing = 0;
+    atomic_init(&buffer->ready, 1);
+    buffer->reading = 2;
+}
+
+Frame *frame_for_writing(TripleBuffer *buffer) {
+    return &buffer->frames[buffer->writing];
+}
+
+void publish_frame(TripleBuffer *buffer) {
+    // Swap our finished slot with the ready one, whatever was there becomes our next slot
+    uint8_t previous = atomic_exchange_explicit(&buffer->ready, buffer->writing | FRAME_FRESH, memory_order_acq_rel);
+    buffer->writing = previous & FRAME_INDEX_MASK;
+}
+
+Frame const *acquire_frame(TripleBuffer *buffer) {
+    if (!(atomic_load_explicit(&buffer->ready, memory_order_relaxed) & FRAME_FRESH)) {
+        return NULL;
+    }
+
+    uint8_t previous = atomic_exchange_explicit(&buffer->ready, buffer->reading, memory_order_acq_rel);
+    buffer->reading = previous & FRAME_INDEX_MASK;
+
+    return &buffer->frames[buffer->reading];
+}
+
+void fill_frame(Frame *frame, Chip8 const *chip, uint64_t number) {
+    frame->number = number;
+    frame->planes = chip->mode >= MODE_XOCHIP ? NUM_OF_PLANES : 1;
+    memcpy(frame->screen, chip->screen, frame->planes * sizeof(frame->screen[0]));
+    frame->hires = chip->hires;
+    frame->colours[0] = chip->background_colour;
+    frame->colours[1] = chip->foreground_colour;
+    frame->colours[2] = DEFAULT_PLANE_2_COLOUR;
+    frame->colours[3] = DEFAULT_OVERLAP_COLOUR;
+}
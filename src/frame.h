@@ -0,0 +1,42 @@
+#ifndef FRAME_H_
+#define FRAME_H_
+
+#include "consts.h"
+#include "structs.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// A finished frame, everything the renderer needs to present it
+typedef struct {
+    uint64_t number;
+    uint64_t screen[NUM_OF_PLANES][HIRES_SCREEN_HEIGHT][SCREEN_ROW_WORDS];
+    // Planes in use, only these have been copied into screen
+    uint8_t planes;
+    bool hires;
+    // Indexed by each pixel's plane bits
+    uint32_t colours[NUM_OF_COLOURS];
+} Frame;
+
+// Lock free single producer/single consumer triple buffer.
+// The producer always has a slot to write to and the consumer always gets the newest frame
+typedef struct {
+    Frame frames[3];
+    // Slot holding the newest frame, FRAME_FRESH is set until the consumer takes it
+    _Atomic uint8_t ready;
+    // Only touched by the producer
+    uint8_t writing;
+    // Only touched by the consumer
+    uint8_t reading;
+} TripleBuffer;
+
+// Copy the machine's screen and colours into a frame
+void fill_frame(Frame *frame, Chip8 const *chip, uint64_t number);
+
+void init_triple_buffer(TripleBuffer *buffer);
+Frame *frame_for_writing(TripleBuffer *buffer);
+void publish_frame(TripleBuffer *buffer);
+// Returns NULL if nothing new has been published since the last call
+Frame const *acquire_frame(TripleBuffer *buffer);
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef HASH_H_
+#define HASH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// XXH64, fast enough that fingerprinting a ROM costs nothing next to loading it
+uint64_t xxh64(void const *data, size_t length, uint64_t seed);
+
+#endif
@@ -1,11 +1,17 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_keycode.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/types.h>
 #include "io.h"
 #include "consts.h"
+#include "render.h"
+#include "ring.h"
+#include "structs.h"
+#include "timing.h"
 
 bool init_display(Display *display, int scale) {
     // Init SDL
@@ -25,15 +31,23 @@ bool init_display(Display *display, int scale) {
     } 
 
     // Create Renderer
-    display->renderer = SDL_CreateRenderer(display->window, -1, SDL_RENDERER_ACCELERATED);
+    display->renderer = SDL_CreateRenderer(display->window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
       
     if (display->renderer == NULL) {
         printf("Renderer could not be created! SDL_Error: %s\n", SDL_GetError());
         return false;
     }
 
-    // Create Texture
-    display->texture = SDL_CreateTexture(display->renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, SCREEN_WIDTH, SCREEN_HEIGHT);
+    // A software renderer scales slower than we can, so expand straight to the window size
+    SDL_RendererInfo info;
+    display->texture_scale = 1;
+    if (SDL_GetRendererInfo(display->renderer, &info) == 0 && (info.flags & SDL_RENDERER_SOFTWARE)) {
+        display->texture_scale = scale;
+    }
+
+    // Create Texture, big enough for high resolution. Low resolution only uses the top left
+    display->texture = SDL_CreateTexture(display->renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING,
+                                         HIRES_SCREEN_WIDTH * display->texture_scale, HIRES_SCREEN_HEIGHT * display->texture_scale);
 
     if (display->texture == NULL) {
         printf("Texture could not be created! SDL_Error: %s\n", SDL_GetError());
@@ -44,20 +58,74 @@ bool init_display(Display *display, int scale) {
     return true;
 }
 
-void update_display(Display *display, void const* buffer, int pitch) {
-    SDL_UpdateTexture(display->texture, NULL, buffer, pitch);
+void update_display(Display *display, Frame const *frame) {
+    void *pixels;
+    int pitch;
+    int width = frame->hires ? HIRES_SCREEN_WIDTH : SCREEN_WIDTH;
+    int height = frame->hires ? HIRES_SCREEN_HEIGHT : SCREEN_HEIGHT;
+    SDL_Rect area = { 0, 0, width * display->texture_scale, height * display->texture_scale };
+
+    // Expand the screen directly into the texture memory
+    if (SDL_LockTexture(display->texture, &area, &pixels, &pitch) == 0) {
+        expand_screen(frame->screen, frame->planes, width, height, frame->colours,
+                      pixels, pitch, display->texture_scale);
+        SDL_UnlockTexture(display->texture);
+    }
+
+    // Only the used part of the texture is stretched over the window
     SDL_RenderClear(display->renderer);
-    SDL_RenderCopy(display->renderer, display->texture, NULL, NULL);
+    SDL_RenderCopy(display->renderer, display->texture, &area, NULL);
     SDL_RenderPresent(display->renderer);
 }
 
-bool process_keyboard_input(Chip8 *chip) {
+// Host key to CHIP-8 key, laid out to match the original hex keypad
+static const struct {
+    SDL_Keycode key;
+    uint16_t mask;
+} KEY_MAP[NUM_OF_KEYS] = {
+    { SDLK_1, KEY_1_MASK }, { SDLK_2, KEY_2_MASK }, { SDLK_3, KEY_3_MASK }, { SDLK_4, KEY_C_MASK },
+    { SDLK_q, KEY_4_MASK }, { SDLK_w, KEY_5_MASK }, { SDLK_e, KEY_6_MASK }, { SDLK_r, KEY_D_MASK },
+    { SDLK_a, KEY_7_MASK }, { SDLK_s, KEY_8_MASK }, { SDLK_d, KEY_9_MASK }, { SDLK_f, KEY_E_MASK },
+    { SDLK_z, KEY_A_MASK }, { SDLK_x, KEY_0_MASK }, { SDLK_c, KEY_B_MASK }, { SDLK_v, KEY_F_MASK },
+};
+
+// Releases that didn't fit in the key queue. Only the main thread queues keys
+static uint16_t pending_releases = 0;
+
+void flush_key_releases(RingBuffer *key_events) {
+    if (pending_releases == 0) {
+        return;
+    }
+
+    KeyEvent event = { now_nanoseconds(), pending_releases, false };
+    if (ring_push(key_events, &event)) {
+        pending_releases = 0;
+    }
+}
+
+void queue_key_event(RingBuffer *key_events, KeyEvent const *event) {
+    // Anything still waiting has to go first to keep the order
+    flush_key_releases(key_events);
+
+    if (event->pressed) {
+        // The key is down again, so the release it was waiting on no longer matters
+        pending_releases &= ~event->mask;
+        if (pending_releases != 0 || !ring_push(key_events, event)) {
+            printf("Dropped key press, emulation is falling behind\n");
+        }
+    } else if (pending_releases != 0 || !ring_push(key_events, event)) {
+        pending_releases |= event->mask;
+    }
+}
+
+bool process_keyboard_input(RingBuffer *key_events, _Atomic bool *fast_forward) {
     SDL_Event event;
 
+    flush_key_releases(key_events);
+
     while (SDL_PollEvent(&event)) {
         if (event.type == SDL_QUIT) {
             return true;
-            break;
         } 
 
         if (event.type == SDL_KEYDOWN || event.type == SDL_KEYUP) {
@@ -65,71 +133,37 @@ bool process_keyboard_input(Chip8 *chip) {
                 return true;
             }   
 
+            // Held keys already count as pressed, repeats would only add noise
+            if (event.key.repeat) continue;
+
+            // Backquote, below Escape, toggles fast forward
+            if (event.key.keysym.sym == SDLK_BACKQUOTE) {
+                if (event.type == SDL_KEYDOWN) {
+                    atomic_store(fast_forward, !atomic_load(fast_forward));
+                }
+                continue;
+            }
+
             // We ignore invalid keys here
-            register_key_press(chip, event.key.keysym.sym);
+            uint16_t mask = map_key(event.key.keysym.sym);
+            if (mask == 0) continue;
+
+            KeyEvent key_event = { now_nanoseconds(), mask, event.type == SDL_KEYDOWN };
+            queue_key_event(key_events, &key_event);
         }   
     }
     
     return false;
 }
 
-bool register_key_press(Chip8 *chip, int key) {
-    bool valid = true;
-    
-    switch(key) {
-        case SDLK_1:
-            chip->keys_pressed ^= KEY_1_MASK;
-            break;
-        case SDLK_2:
-            chip->keys_pressed ^= KEY_2_MASK;
-            break;
-        case SDLK_3:
-            chip->keys_pressed ^= KEY_3_MASK;
-            break;
-        case SDLK_4:
-            chip->keys_pressed ^= KEY_C_MASK;
-            break;
-        case SDLK_q:
-            chip->keys_pressed ^= KEY_4_MASK;
-            break;
-        case SDLK_w:
-            chip->keys_pressed ^= KEY_5_MASK;
-            break;
-        case SDLK_e:
-            chip->keys_pressed ^= KEY_6_MASK;
-            break;
-        case SDLK_r:
-            chip->keys_pressed ^= KEY_D_MASK;
-            break;
-        case SDLK_a:
-            chip->keys_pressed ^= KEY_7_MASK;
-            break;
-        case SDLK_s:
-            chip->keys_pressed ^= KEY_8_MASK;
-            break;
-        case SDLK_d:
-            chip->keys_pressed ^= KEY_9_MASK;
-            break;
-        case SDLK_f:
-            chip->keys_pressed ^= KEY_E_MASK;
-            break;
-        case SDLK_z:
-            chip->keys_pressed ^= KEY_A_MASK;
-            break;
-        case SDLK_x:
-            chip->keys_pressed ^= KEY_0_MASK;
-            break;
-        case SDLK_c:
-            chip->keys_pressed ^= KEY_B_MASK;
-            break;
-        case SDLK_v:
-            chip->keys_pressed ^= KEY_F_MASK;
-            break;
-        default:
-            valid = false; 
-    }    
-
-    return valid;
+uint16_t map_key(int key) {
+    for (int i = 0; i < NUM_OF_KEYS; i++) {
+        if (KEY_MAP[i].key == key) {
+            return KEY_MAP[i].mask;
+        }
+    }
+
+    return 0;
 }
 
 void cleanup_display(Display *display) {
@@ -2,19 +2,31 @@
 #define IO_H_
 
 #include <SDL2/SDL.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include "frame.h"
+#include "ring.h"
 #include "structs.h"
 
 typedef struct {
     SDL_Window *window;
     SDL_Renderer *renderer;
     SDL_Texture *texture;
+    // Upscale applied while expanding into the texture, 1 when the GPU does the scaling
+    int texture_scale;
 } Display;
 
 bool init_display(Display *display, int scale);
-void update_display(Display *display, void const* buffer, int pitch);
-bool process_keyboard_input(Chip8 *chip);
-bool register_key_press(Chip8 *chip, int key);
+void update_display(Display *display, Frame const *frame);
+// The fast forward hotkey flips fast_forward
+bool process_keyboard_input(RingBuffer *key_events, _Atomic bool *fast_forward);
+// Queues a key change for the emulation thread. Releases that don't fit are kept and sent
+// ahead of the next event queued, or by flush_key_releases, so keys can't get stuck down
+void queue_key_event(RingBuffer *key_events, KeyEvent const *event);
+void flush_key_releases(RingBuffer *key_events);
+// Returns the CHIP-8 key mask for a host key, or 0 if it isn't mapped
+uint16_t map_key(int key);
 void cleanup_display(Display *display);
 int read_user_character_input();
 int read_user_integer_input();
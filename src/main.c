@@ -1,23 +1,228 @@
 #include "chip8.h"
 #include "consts.h"
 #include "debug.h"
+#include "emulator.h"
+#include "frame.h"
 #include "io.h"
 #include "structs.h"
 #include "args.h"
+#include "audio.h"
+#include "capture.h"
+#include "romdb.h"
+#include "scheduler.h"
+#include "server.h"
+#include "shm.h"
+#include "stats.h"
+#include "timing.h"
+#include "trace.h"
+#include "tty.h"
+#include "wall.h"
+#include <limits.h>
+#include <signal.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
+#include <unistd.h>
+
+// Set by SIGUSR1, the stats are printed from the main loop so emulation never stops
+static volatile sig_atomic_t stats_requested = 0;
+
+static void request_stats(int signal) {
+    stats_requested = 1;
+}
+
+// Instances without a window have nothing to close, so they stop on SIGINT or SIGTERM
+static volatile sig_atomic_t stop_requested = 0;
+
+static void request_stop(int signal) {
+    stop_requested = 1;
+}
+
+// Everything main starts around the emulator, each is NULL when not in use
+typedef struct {
+    Display *display;
+    Audio *audio;
+    Tracer *tracer;
+    SharedFrame *shared;
+    Server *server;
+    Capture *capture;
+    Tty *tty;
+} Frontends;
+
+static void cleanup_frontends(Frontends *frontends, Args const *args) {
+    if (frontends->capture != NULL) stop_capture(frontends->capture);
+    if (frontends->server != NULL) stop_server(frontends->server);
+    if (frontends->shared != NULL) cleanup_shared_frame(frontends->shared, args->shm);
+    if (frontends->tracer != NULL) stop_trace(frontends->tracer);
+    if (frontends->audio != NULL) cleanup_audio(frontends->audio);
+    if (frontends->display != NULL) cleanup_display(frontends->display);
+    if (frontends->tty != NULL) cleanup_tty(frontends->tty);
+}
+
+// Fill in anything not given on the command line from the ROM's database entry
+static void apply_rom_database(Args const *args, Chip8 *chip, uint64_t *cycles_per_frame) {
+    RomDatabase database;
+    uint32_t colour;
+
+    if (!open_rom_database(&database, args->rom_database)) {
+        return;
+    }
+
+    RomEntry const *entry = find_rom(&database, chip->rom_hash);
+    if (entry != NULL) {
+        if (!args->custom_cycles && entry->cycles_per_frame > 0) {
+            *cycles_per_frame = entry->cycles_per_frame;
+        }
+
+        if (!args->custom_quirks && entry->quirks != ROM_ENTRY_UNSET) {
+            set_quirks(chip, entry->quirks);
+        }
+
+        if (!args->custom_foreground && convert_input_to_colour(entry->foreground, &colour)) {
+            chip->foreground_colour = colour;
+        }
+
+        if (!args->custom_background && convert_input_to_colour(entry->background, &colour)) {
+            chip->background_colour = colour;
+        }
+    }
+
+    close_rom_database(&database);
+}
+
+// Each session shares its frames and keys through its own segment, named <--shm>-<index>
+static void session_shm_name(char *name, size_t size, char const *base, int index) {
+    snprintf(name, size, "%s-%d", base, index);
+}
+
+// Runs on the worker after every frame of a session with a segment
+static void publish_session_frame(Session *session) {
+    Frame frame;
+
+    fill_frame(&frame, session->chip, session->frames);
+    publish_shared_frame(session->user, &frame);
+}
+
+static void free_sessions(Session *sessions, int count, char const *shm) {
+    char name[NAME_MAX];
+
+    for (int i = 0; i < count; i++) {
+        if (sessions[i].user != NULL) {
+            session_shm_name(name, sizeof(name), shm, i);
+            cleanup_shared_frame(sessions[i].user, name);
+        }
+        free(sessions[i].chip);
+    }
+    free(sessions);
+}
+
+// Runs copies of the ROM headlessly on the scheduler until SIGINT or SIGTERM
+static bool run_sessions(Args const *args, Chip8 *chip, uint64_t cycles_per_frame) {
+    Scheduler scheduler;
+    char name[NAME_MAX];
+    int workers = args->workers;
+
+    if (workers == 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = cores > 0 ? (int) cores : 1;
+    }
+
+    Session *sessions = calloc(args->sessions, sizeof(Session));
+    if (sessions == NULL) {
+        printf("ERROR: Failed to assign memory for sessions!\n");
+        return false;
+    }
+
+    // Every session starts as a copy of the freshly loaded machine
+    for (int i = 0; i < args->sessions; i++) {
+        sessions[i].chip = malloc(chip8_size(chip));
+        if (sessions[i].chip == NULL) {
+            printf("ERROR: Failed to assign memory for session %d!\n", i);
+            free_sessions(sessions, i, args->shm);
+            return false;
+        }
+        copy_chip8(sessions[i].chip, chip);
+        sessions[i].cycles_per_frame = cycles_per_frame;
+
+        if (args->shm != NULL) {
+            session_shm_name(name, sizeof(name), args->shm, i);
+            sessions[i].user = create_shared_frame(name);
+            if (sessions[i].user == NULL) {
+                free_sessions(sessions, i + 1, args->shm);
+                return false;
+            }
+            sessions[i].frame_done = publish_session_frame;
+        }
+    }
+
+    if (!start_scheduler(&scheduler, workers)) {
+        free_sessions(sessions, args->sessions, args->shm);
+        return false;
+    }
+
+    struct sigaction action = { 0 };
+    action.sa_handler = request_stats;
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &action, NULL);
+    action.sa_handler = request_stop;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    for (int i = 0; i < args->sessions; i++) {
+        if (!schedule_session(&scheduler, &sessions[i])) {
+            printf("ERROR: Failed to schedule session %d!\n", i);
+            stop_requested = 1;
+            break;
+        }
+    }
+
+    // The workers do the emulation, this thread passes on key changes from the segments,
+    // which is what wakes sessions parked on FX0A
+    uint64_t started = now_nanoseconds();
+    struct timespec idle = { 0, NANOSECS_IN_SECOND / 1000 };
+    while (!stop_requested) {
+        if (stats_requested) {
+            stats_requested = 0;
+            print_scheduler_stats(&scheduler, args->sessions);
+        }
+
+        if (args->shm != NULL) {
+            for (int i = 0; i < args->sessions; i++) {
+                uint16_t keys = shared_keys(sessions[i].user);
+                if (keys != atomic_load_explicit(&sessions[i].keys, memory_order_relaxed)) {
+                    set_session_keys(&scheduler, &sessions[i], keys);
+                }
+            }
+        }
+        nanosleep(&idle, NULL);
+    }
+
+    stop_scheduler(&scheduler);
+
+    double seconds = (double) (now_nanoseconds() - started) / NANOSECS_IN_SECOND;
+    print_scheduler_stats(&scheduler, args->sessions);
+    printf("%.1f frames per second per session\n", (double) atomic_load(&scheduler.frames) / seconds / args->sessions);
+
+    free_sessions(sessions, args->sessions, args->shm);
+    return true;
+}
 
 int main(int argc, char *argv[]) {
-    uint64_t delay, cycles_per_frame;
+    uint64_t cycles_per_frame;
     Display display;
-    Chip8 chip;
+    Chip8 *chip;
+    Emulator emulator;
+    Audio audio;
+    Tracer tracer;
+    Server server;
+    Capture capture;
+    Tty tty;
+    Frontends frontends = { 0 };
     Debugger *debugger = NULL;
     bool quit = false;
-    struct timespec now, last_cycle;
-    uint64_t diff = 0;
 
     if (argc < 2) {
         usage();
@@ -34,6 +239,11 @@ int main(int argc, char *argv[]) {
         return 0;
     }
 
+    // Every tile runs on this thread, so none of the single instance machinery applies
+    if (args.wall) {
+        return run_wall(&args) ? 0 : 1;
+    }
+
     if (args.debug) {
         debugger = malloc(sizeof(Debugger));
         if (debugger == NULL) {
@@ -43,65 +253,152 @@ int main(int argc, char *argv[]) {
         init_debugger(debugger);
     }
 
-    init_chip8(&chip, debugger, args.foreground, args.background);
+    chip = create_chip8(debugger, args.mode, args.quirks, args.foreground, args.background);
+    if (chip == NULL) {
+        return 1;
+    }
 
-    if (load_rom(&chip, args.rom)) {
+    if (load_rom(chip, args.rom)) {
         // Exit because we found an error
         printf("Exiting\n");
         return 1;
     }
 
-    // Startup SDL
-    if (!init_display(&display, args.scale)) {
-        printf("Failed to initialize display\n");
-        return 1;
+    // Sessions are headless and don't need anything around them
+    if (args.sessions > 0) {
+        cycles_per_frame = args.target_cycles / TARGET_FRAMES_PER_SECOND;
+        apply_rom_database(&args, chip, &cycles_per_frame);
+
+        bool success = run_sessions(&args, chip, cycles_per_frame);
+        cleanup_chip8(chip);
+        return success ? 0 : 1;
     }
 
-    update_display(&display, &chip.screen, PITCH);
+    // A served instance is headless, its clients do the showing
+    if (args.serve != NULL) {
+        if (!start_server(&server, args.serve)) {
+            return 1;
+        }
+        frontends.server = &server;
+    } else if (args.tty) {
+        if (!init_tty(&tty)) {
+            return 1;
+        }
+        frontends.tty = &tty;
+    } else {
+        // Startup SDL
+        if (!init_display(&display, args.scale)) {
+            printf("Failed to initialize display\n");
+            return 1;
+        }
+        frontends.display = &display;
+
+        // Missing audio isn't fatal, we just run silently
+        if (init_audio(&audio)) {
+            frontends.audio = &audio;
+        } else {
+            printf("Continuing without sound\n");
+        }
+    }
 
     // Calculate CPU timing 
-    delay = MICROSECS_IN_SECOND / TARGET_FRAMES_PER_SECOND;
     cycles_per_frame = args.target_cycles / TARGET_FRAMES_PER_SECOND;
+    apply_rom_database(&args, chip, &cycles_per_frame);
 
-    clock_gettime(CLOCK_MONOTONIC_RAW, &last_cycle);
+    if (args.trace_out != NULL) {
+        if (!start_trace(&tracer, args.trace_out)) {
+            cleanup_frontends(&frontends, &args);
+            return 1;
+        }
+        frontends.tracer = &tracer;
+    }
+
+    if (args.shm != NULL) {
+        frontends.shared = create_shared_frame(args.shm);
+        if (frontends.shared == NULL) {
+            cleanup_frontends(&frontends, &args);
+            return 1;
+        }
+    }
+
+    if (args.capture != NULL) {
+        if (!start_capture(&capture, args.capture, args.capture_raw, args.scale)) {
+            cleanup_frontends(&frontends, &args);
+            return 1;
+        }
+        frontends.capture = &capture;
+    }
+
+    if (!start_emulator(&emulator, chip, cycles_per_frame, args.run_ahead, args.turbo, args.fast_forward,
+                        frontends.audio, frontends.tracer, frontends.shared, frontends.capture)) {
+        cleanup_frontends(&frontends, &args);
+        return 1;
+    }
+
+    struct sigaction action = { 0 };
+    action.sa_handler = request_stats;
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &action, NULL);
+
+    if (frontends.display == NULL) {
+        action.sa_handler = request_stop;
+        sigaction(SIGINT, &action, NULL);
+        sigaction(SIGTERM, &action, NULL);
+    }
+
+    // This thread only handles events and presents whatever frame is newest
+    struct timespec idle = { 0, NANOSECS_IN_SECOND / 1000 };
+    uint64_t last_frame = 0;
     while (!quit) {
-        quit = process_keyboard_input(&chip);
-        // This is needed for ESC to work during debug mode
+        uint64_t start = now_nanoseconds();
+        if (frontends.server != NULL) {
+            // Waits for client activity instead of idling
+            poll_server(frontends.server, &emulator.key_events, 1);
+            quit = stop_requested || atomic_load(&emulator.quit);
+        } else if (frontends.tty != NULL) {
+            quit = process_tty_input(frontends.tty, &emulator.key_events, &emulator.fast_forward) || stop_requested ||
+                   atomic_load(&emulator.quit);
+        } else {
+            quit = process_keyboard_input(&emulator.key_events, &emulator.fast_forward) || atomic_load(&emulator.quit);
+        }
+        trace_event(frontends.tracer, TRACE_MAIN_THREAD, TRACE_POLL, start, now_nanoseconds());
         if (quit) continue;
-        
-        clock_gettime(CLOCK_MONOTONIC_RAW, &now);
-        diff = (now.tv_sec - last_cycle.tv_sec) * MICROSECS_IN_SECOND +
-               (now.tv_nsec - last_cycle.tv_nsec) / NANOSECS_IN_MICROSECONDS;
 
-        if (diff > delay) {
-            last_cycle = now;
-
-            update_display(&display, &chip.screen, PITCH);
-            update_timers(&chip);
+        if (stats_requested) {
+            stats_requested = 0;
+            print_stats(&emulator.stats, args.rom);
+        }
 
-            if (chip.waiting_to_draw > 2) {
-                chip.display_interrupt_triggered = true;
+        Frame const *frame = acquire_frame(&emulator.frames);
+        if (frame != NULL) {
+            if (frame->number > last_frame + 1) {
+                atomic_fetch_add(&emulator.stats.dropped_frames, frame->number - last_frame - 1);
             }
+            last_frame = frame->number;
 
-            for (int i = 0; i < cycles_per_frame; i++) {
-                if (chip.debugger != NULL) {
-                    quit = chip.debugger->exit;
-                    if (!quit && chip.debugger->stepping) {
-                        quit = debug_prompt_user(chip.debugger, &chip);
-                    }
-
-                    // Prevent execution of instruction when we quit the debugger
-                    if (quit) break;
-                }
-                cycle(&chip);
-                
-            } 
+            start = now_nanoseconds();
+            if (frontends.server != NULL) {
+                broadcast_frame(frontends.server, frame);
+            } else if (frontends.tty != NULL) {
+                update_tty(frontends.tty, frame);
+            } else {
+                update_display(frontends.display, frame);
+            }
+            uint64_t end = now_nanoseconds();
+            record_value(&emulator.stats.present, end - start);
+            trace_event(frontends.tracer, TRACE_MAIN_THREAD, TRACE_PRESENT, start, end);
+        } else if (frontends.server == NULL) {
+            nanosleep(&idle, NULL);
         }
     }
 
-    // Free and close SDL and Chip8
-    cleanup_display(&display);
-    cleanup_chip8(&chip);
+    stop_emulator(&emulator);
+
+    // Free and close everything around the Chip8, then the Chip8. The terminal has to be
+    // back to normal before the stats are printed
+    cleanup_frontends(&frontends, &args);
+    print_stats(&emulator.stats, args.rom);
+    cleanup_chip8(chip);
 
     return 0;
 }
@@ -0,0 +1,186 @@
+#include "render.h"
+#include "consts.h"
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define RENDER_X86
+#endif
+
+// Expands a single 64 pixel row word, the most significant bit is the leftmost pixel.
+// The one plane version picks between colours 0 and 1, the two plane version between all four
+typedef void (*ExpandRow)(uint64_t row, uint32_t const *colours, uint32_t *out);
+typedef void (*ExpandPlanes)(uint64_t first, uint64_t second, uint32_t const *colours, uint32_t *out);
+
+static void expand_row_scalar(uint64_t row, uint32_t const *colours, uint32_t *out) {
+    uint32_t diff = colours[0] ^ colours[1];
+
+    // Select the colour with a mask rather than a branch
+    for (int i = 0; i < ROW_WORD_BITS; i++) {
+        uint32_t mask = -(uint32_t) ((row >> (63 - i)) & 1);
+        out[i] = colours[0] ^ (diff & mask);
+    }
+}
+
+static void expand_planes_scalar(uint64_t first, uint64_t second, uint32_t const *colours, uint32_t *out) {
+    for (int i = 0; i < ROW_WORD_BITS; i++) {
+        int index = ((first >> (63 - i)) & 1) | (((second >> (63 - i)) & 1) << 1);
+        out[i] = colours[index];
+    }
+}
+
+#ifdef RENDER_X86
+#ifdef __SSE2__
+// Lane 0 is the leftmost pixel, so it tests the highest bit of the byte
+#define SSE2_HIGH_BITS _mm_set_epi32(0x10, 0x20, 0x40, 0x80)
+#define SSE2_LOW_BITS _mm_set_epi32(0x01, 0x02, 0x04, 0x08)
+
+static inline __m128i sse2_mask(__m128i bits, __m128i select) {
+    return _mm_cmpeq_epi32(_mm_and_si128(bits, select), select);
+}
+
+// Picks b where mask is set and a elsewhere
+static inline __m128i sse2_select(__m128i a, __m128i b, __m128i mask) {
+    return _mm_xor_si128(a, _mm_and_si128(_mm_xor_si128(a, b), mask));
+}
+
+static void expand_row_sse2(uint64_t row, uint32_t const *colours, uint32_t *out) {
+    __m128i bg = _mm_set1_epi32(colours[0]);
+    __m128i fg = _mm_set1_epi32(colours[1]);
+
+    for (int i = 0; i < ROW_WORD_BITS / 8; i++) {
+        __m128i bits = _mm_set1_epi32((row >> (56 - i * 8)) & 0xFF);
+
+        _mm_storeu_si128((__m128i *) (out + i * 8), sse2_select(bg, fg, sse2_mask(bits, SSE2_HIGH_BITS)));
+        _mm_storeu_si128((__m128i *) (out + i * 8 + 4), sse2_select(bg, fg, sse2_mask(bits, SSE2_LOW_BITS)));
+    }
+}
+
+static void expand_planes_sse2(uint64_t first, uint64_t second, uint32_t const *colours, uint32_t *out) {
+    __m128i c0 = _mm_set1_epi32(colours[0]);
+    __m128i c1 = _mm_set1_epi32(colours[1]);
+    __m128i c2 = _mm_set1_epi32(colours[2]);
+    __m128i c3 = _mm_set1_epi32(colours[3]);
+
+    for (int i = 0; i < ROW_WORD_BITS / 4; i++) {
+        __m128i select = (i & 1) ? SSE2_LOW_BITS : SSE2_HIGH_BITS;
+        __m128i m0 = sse2_mask(_mm_set1_epi32((first >> (56 - (i / 2) * 8)) & 0xFF), select);
+        __m128i m1 = sse2_mask(_mm_set1_epi32((second >> (56 - (i / 2) * 8)) & 0xFF), select);
+
+        __m128i low = sse2_select(c0, c1, m0);
+        __m128i high = sse2_select(c2, c3, m0);
+        _mm_storeu_si128((__m128i *) (out + i * 4), sse2_select(low, high, m1));
+    }
+}
+#endif
+
+#define AVX2_BITS _mm256_set_epi32(0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80)
+
+__attribute__((target("avx2")))
+static inline __m256i avx2_mask(uint64_t row, int byte) {
+    __m256i bits = _mm256_set1_epi32((row >> (56 - byte * 8)) & 0xFF);
+    return _mm256_cmpeq_epi32(_mm256_and_si256(bits, AVX2_BITS), AVX2_BITS);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i avx2_select(__m256i a, __m256i b, __m256i mask) {
+    return _mm256_xor_si256(a, _mm256_and_si256(_mm256_xor_si256(a, b), mask));
+}
+
+__attribute__((target("avx2")))
+static void expand_row_avx2(uint64_t row, uint32_t const *colours, uint32_t *out) {
+    __m256i bg = _mm256_set1_epi32(colours[0]);
+    __m256i fg = _mm256_set1_epi32(colours[1]);
+
+    for (int i = 0; i < ROW_WORD_BITS / 8; i++) {
+        _mm256_storeu_si256((__m256i *) (out + i * 8), avx2_select(bg, fg, avx2_mask(row, i)));
+    }
+}
+
+__attribute__((target("avx2")))
+static void expand_planes_avx2(uint64_t first, uint64_t second, uint32_t const *colours, uint32_t *out) {
+    __m256i c0 = _mm256_set1_epi32(colours[0]);
+    __m256i c1 = _mm256_set1_epi32(colours[1]);
+    __m256i c2 = _mm256_set1_epi32(colours[2]);
+    __m256i c3 = _mm256_set1_epi32(colours[3]);
+
+    for (int i = 0; i < ROW_WORD_BITS / 8; i++) {
+        __m256i m0 = avx2_mask(first, i);
+        __m256i low = avx2_select(c0, c1, m0);
+        __m256i high = avx2_select(c2, c3, m0);
+
+        _mm256_storeu_si256((__m256i *) (out + i * 8), avx2_select(low, high, avx2_mask(second, i)));
+    }
+}
+#endif
+
+static ExpandRow expand_row = NULL;
+static ExpandPlanes expand_planes = NULL;
+
+// Pick the widest kernels the CPU supports
+static void select_kernels() {
+    expand_row = expand_row_scalar;
+    expand_planes = expand_planes_scalar;
+
+#ifdef RENDER_X86
+#ifdef __SSE2__
+    expand_row = expand_row_sse2;
+    expand_planes = expand_planes_sse2;
+#endif
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        expand_row = expand_row_avx2;
+        expand_planes = expand_planes_avx2;
+    }
+#endif
+}
+
+static void expand_line(uint64_t const (*screen)[HIRES_SCREEN_HEIGHT][SCREEN_ROW_WORDS], int planes, int y, int words,
+                        uint32_t const *colours, uint32_t *out) {
+    for (int w = 0; w < words; w++) {
+        if (planes == 1) {
+            expand_row(screen[0][y][w], colours, out + w * ROW_WORD_BITS);
+        } else {
+            expand_planes(screen[0][y][w], screen[1][y][w], colours, out + w * ROW_WORD_BITS);
+        }
+    }
+}
+
+void expand_screen(uint64_t const (*screen)[HIRES_SCREEN_HEIGHT][SCREEN_ROW_WORDS], int planes, int width, int height,
+                   uint32_t const colours[NUM_OF_COLOURS], void *pixels, int pitch, int scale) {
+    if (expand_row == NULL) {
+        select_kernels();
+    }
+
+    uint8_t *dest = pixels;
+    int words = width / ROW_WORD_BITS;
+
+    if (scale == 1) {
+        for (int y = 0; y < height; y++) {
+            expand_line(screen, planes, y, words, colours, (uint32_t *) dest);
+            dest += pitch;
+        }
+        return;
+    }
+
+    uint32_t line[HIRES_SCREEN_WIDTH];
+    size_t scaled_row_size = width * scale * sizeof(uint32_t);
+
+    for (int y = 0; y < height; y++) {
+        expand_line(screen, planes, y, words, colours, line);
+
+        uint32_t *out = (uint32_t *) dest;
+        for (int x = 0; x < width; x++) {
+            for (int s = 0; s < scale; s++) {
+                *out++ = line[x];
+            }
+        }
+
+        // The remaining rows for this pixel row are identical
+        for (int s = 1; s < scale; s++) {
+            memcpy(dest + s * pitch, dest, scaled_row_size);
+        }
+        dest += pitch * scale;
+    }
+}
@@ -0,0 +1,14 @@
+#ifndef RENDER_H_
+#define RENDER_H_
+
+#include "consts.h"
+#include <stdint.h>
+
+// Compose the top left width x height of the bit planes into RGBA8888 pixels.
+// Each pixel's plane bits index colours, so only planes' worth of rows are read.
+// width must be a multiple of ROW_WORD_BITS, pitch is the length of a destination row
+// in bytes and scale is an integer upscale factor
+void expand_screen(uint64_t const (*screen)[HIRES_SCREEN_HEIGHT][SCREEN_ROW_WORDS], int planes, int width, int height,
+                   uint32_t const colours[NUM_OF_COLOURS], void *pixels, int pitch, int scale);
+
+#endif
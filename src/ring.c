@@ -0,0 +1,69 @@
+#include "ring.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool init_ring_buffer(RingBuffer *ring, size_t capacity, size_t item_size) {
+    // Round up so we can mask instead of using modulo
+    size_t size = 1;
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    ring->items = malloc(size * item_size);
+    if (ring->items == NULL) {
+        return false;
+    }
+
+    ring->capacity = size;
+    ring->item_size = item_size;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+
+    return true;
+}
+
+void cleanup_ring_buffer(RingBuffer *ring) {
+    free(ring->items);
+    ring->items = NULL;
+}
+
+bool ring_push(RingBuffer *ring, void const *item) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    if (head - tail == ring->capacity) {
+        return false;
+    }
+
+    memcpy(ring->items + (head & (ring->capacity - 1)) * ring->item_size, item, ring->item_size);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+    return true;
+}
+
+bool ring_peek(RingBuffer *ring, void *item) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    if (head == tail) {
+        return false;
+    }
+
+    memcpy(item, ring->items + (tail & (ring->capacity - 1)) * ring->item_size, ring->item_size);
+
+    return true;
+}
+
+bool ring_pop(RingBuffer *ring, void *item) {
+    if (!ring_peek(ring, item)) {
+        return false;
+    }
+
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+
+    return true;
+}
@@ -0,0 +1,30 @@
+#ifndef RING_H_
+#define RING_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Lock free single producer/single consumer queue of fixed size items.
+// Storage is allocated up front so pushing and popping never allocate
+typedef struct {
+    // Only written by the producer
+    _Atomic size_t head;
+    // Only written by the consumer
+    _Atomic size_t tail;
+    // Always a power of two
+    size_t capacity;
+    size_t item_size;
+    uint8_t *items;
+} RingBuffer;
+
+bool init_ring_buffer(RingBuffer *ring, size_t capacity, size_t item_size);
+void cleanup_ring_buffer(RingBuffer *ring);
+// Returns false instead of waiting when the ring is full
+bool ring_push(RingBuffer *ring, void const *item);
+// Copy the oldest item without removing it, returns false when empty
+bool ring_peek(RingBuffer *ring, void *item);
+bool ring_pop(RingBuffer *ring, void *item);
+
+#endif
@@ -0,0 +1,120 @@
+#include "romdb.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+_Static_assert(sizeof(RomDatabaseHeader) == 16, "RomDatabaseHeader must match the file format");
+_Static_assert(sizeof(RomEntry) == 16, "RomEntry must match the file format");
+
+bool open_rom_database(RomDatabase *database, char const *path) {
+    struct stat info;
+
+    database->map = NULL;
+    database->size = 0;
+    database->entries = NULL;
+    database->count = 0;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        if (errno != ENOENT) {
+            printf("Failed to open ROM database %s: %s\n", path, strerror(errno));
+        }
+        return false;
+    }
+
+    if (fstat(fd, &info) != 0 || info.st_size < (off_t) sizeof(RomDatabaseHeader)) {
+        printf("ROM database %s is too small\n", path);
+        close(fd);
+        return false;
+    }
+
+    // Only the pages the binary search touches ever get read in
+    void *map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        printf("Failed to map ROM database %s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    RomDatabaseHeader const *header = map;
+    size_t expected = sizeof(RomDatabaseHeader) + (size_t) header->count * sizeof(RomEntry);
+    if (header->magic != ROM_DATABASE_MAGIC || header->version != ROM_DATABASE_VERSION || expected > (size_t) info.st_size) {
+        printf("ROM database %s is invalid\n", path);
+        munmap(map, info.st_size);
+        return false;
+    }
+
+    database->map = map;
+    database->size = info.st_size;
+    database->entries = (RomEntry const *) (header + 1);
+    database->count = header->count;
+
+    return true;
+}
+
+void close_rom_database(RomDatabase *database) {
+    if (database->map != NULL) {
+        munmap(database->map, database->size);
+    }
+
+    database->map = NULL;
+    database->entries = NULL;
+    database->count = 0;
+}
+
+RomEntry const *find_rom(RomDatabase const *database, uint64_t hash) {
+    uint32_t low = 0;
+    uint32_t high = database->count;
+
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        uint64_t current = database->entries[middle].hash;
+
+        if (current == hash) {
+            return &database->entries[middle];
+        } else if (current < hash) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return NULL;
+}
+
+static int compare_entries(void const *a, void const *b) {
+    uint64_t first = ((RomEntry const *) a)->hash;
+    uint64_t second = ((RomEntry const *) b)->hash;
+
+    return (first > second) - (first < second);
+}
+
+bool write_rom_database(char const *path, RomEntry *entries, uint32_t count) {
+    RomDatabaseHeader header = { ROM_DATABASE_MAGIC, ROM_DATABASE_VERSION, count, 0 };
+
+    qsort(entries, count, sizeof(RomEntry), compare_entries);
+
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) {
+        printf("Failed to open %s for writing\n", path);
+        return false;
+    }
+
+    bool success = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+                   fwrite(entries, sizeof(RomEntry), count, fp) == count;
+
+    if (fclose(fp) != 0) success = false;
+
+    if (!success) {
+        printf("Failed to write ROM database %s\n", path);
+    }
+
+    return success;
+}
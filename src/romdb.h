@@ -0,0 +1,51 @@
+#ifndef ROMDB_H_
+#define ROMDB_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// On disk the database is a RomDatabaseHeader followed by count RomEntry records
+// sorted by hash, in host byte order. It's mapped straight in and binary searched
+#define ROM_DATABASE_MAGIC 0x42443843 // "C8DB"
+#define ROM_DATABASE_VERSION 1
+#define DEFAULT_ROM_DATABASE "roms.db"
+
+// Marks a field the database has no recommendation for
+#define ROM_ENTRY_UNSET 0xFF
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t reserved;
+} RomDatabaseHeader;
+
+typedef struct {
+    // xxh64 of the ROM file's contents
+    uint64_t hash;
+    // 0 if there's no recommended speed
+    uint32_t cycles_per_frame;
+    uint8_t quirks;
+    // Colour numbers as taken by -f and -b
+    uint8_t foreground;
+    uint8_t background;
+    uint8_t reserved;
+} RomEntry;
+
+typedef struct {
+    void *map;
+    size_t size;
+    RomEntry const *entries;
+    uint32_t count;
+} RomDatabase;
+
+// A missing database isn't an error, it just has nothing in it
+bool open_rom_database(RomDatabase *database, char const *path);
+void close_rom_database(RomDatabase *database);
+// Returns NULL if the ROM isn't known
+RomEntry const *find_rom(RomDatabase const *database, uint64_t hash);
+// Sorts the entries in place and writes them out
+bool write_rom_database(char const *path, RomEntry *entries, uint32_t count);
+
+#endif
@@ -0,0 +1,334 @@
+#include "scheduler.h"
+#include "chip8.h"
+#include "consts.h"
+#include "structs.h"
+#include "timing.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Binary min heap on deadline, the caller holds the worker's lock. schedule_session makes
+// every heap big enough for every session, so there's always room
+static void heap_push(Worker *worker, Session *session) {
+    size_t i = worker->count++;
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (worker->heap[parent]->deadline <= session->deadline) break;
+
+        worker->heap[i] = worker->heap[parent];
+        i = parent;
+    }
+    worker->heap[i] = session;
+}
+
+static Session *heap_pop(Worker *worker) {
+    Session *top = worker->heap[0];
+    Session *last = worker->heap[--worker->count];
+    size_t i = 0;
+
+    while (true) {
+        size_t child = i * 2 + 1;
+        if (child >= worker->count) break;
+        if (child + 1 < worker->count && worker->heap[child + 1]->deadline < worker->heap[child]->deadline) child++;
+        if (last->deadline <= worker->heap[child]->deadline) break;
+
+        worker->heap[i] = worker->heap[child];
+        i = child;
+    }
+    if (worker->count > 0) {
+        worker->heap[i] = last;
+    }
+
+    return top;
+}
+
+static void push_session(Worker *worker, Session *session) {
+    pthread_mutex_lock(&worker->lock);
+
+    atomic_store(&session->state, SESSION_QUEUED);
+    heap_push(worker, session);
+
+    // A new earliest deadline means the worker may be sleeping past it
+    if (worker->heap[0] == session) {
+        pthread_cond_signal(&worker->wake);
+    }
+
+    pthread_mutex_unlock(&worker->lock);
+}
+
+// Sessions move between workers when they're stolen or woken, so any heap may end up holding all of them.
+// Growing the heaps here means nothing is ever lost to a failed allocation once it's running
+static bool reserve_session(Scheduler *scheduler) {
+    size_t needed = atomic_fetch_add(&scheduler->sessions, 1) + 1;
+
+    for (int i = 0; i < scheduler->num_of_workers; i++) {
+        Worker *worker = &scheduler->workers[i];
+        bool grown = true;
+
+        pthread_mutex_lock(&worker->lock);
+        if (worker->capacity < needed) {
+            size_t capacity = worker->capacity * 2 > needed ? worker->capacity * 2 : needed;
+            Session **heap = realloc(worker->heap, capacity * sizeof(Session *));
+            if (heap != NULL) {
+                worker->heap = heap;
+                worker->capacity = capacity;
+            } else {
+                grown = false;
+            }
+        }
+        pthread_mutex_unlock(&worker->lock);
+
+        if (!grown) {
+            atomic_fetch_sub(&scheduler->sessions, 1);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static Worker *pick_worker(Scheduler *scheduler) {
+    uint32_t next = atomic_fetch_add_explicit(&scheduler->next_worker, 1, memory_order_relaxed);
+    return &scheduler->workers[next % scheduler->num_of_workers];
+}
+
+// Takes the earliest session if it's due, lock must be held
+static Session *pop_due(Worker *worker, uint64_t now) {
+    if (worker->count == 0 || worker->heap[0]->deadline > now) {
+        return NULL;
+    }
+
+    Session *session = heap_pop(worker);
+    atomic_store(&session->state, SESSION_RUNNING);
+    return session;
+}
+
+// Never waits on a busy worker, there'll be another chance soon enough
+static Session *steal(Worker *thief, uint64_t now) {
+    Scheduler *scheduler = thief->scheduler;
+
+    for (int i = 1; i < scheduler->num_of_workers; i++) {
+        Worker *victim = &scheduler->workers[(thief->index + i) % scheduler->num_of_workers];
+        if (pthread_mutex_trylock(&victim->lock) != 0) continue;
+
+        Session *session = pop_due(victim, now);
+        pthread_mutex_unlock(&victim->lock);
+
+        if (session != NULL) {
+            atomic_fetch_add_explicit(&scheduler->steals, 1, memory_order_relaxed);
+            return session;
+        }
+    }
+
+    return NULL;
+}
+
+// Waiting on a key with no timers running, so frames would change nothing
+static bool idle(Chip8 const *chip) {
+    return chip->waiting_for_key && chip->keys_pressed == chip->keys_snapshot && chip->delay_timer == 0 &&
+           chip->sound_timer == 0;
+}
+
+static void run_session(Worker *worker, Session *session) {
+    Scheduler *scheduler = worker->scheduler;
+    Chip8 *chip = session->chip;
+    uint64_t delay = NANOSECS_IN_SECOND / TARGET_FRAMES_PER_SECOND;
+
+    chip->keys_pressed = atomic_load(&session->keys);
+    run_frame(chip, session->cycles_per_frame);
+    session->frames++;
+    atomic_fetch_add_explicit(&scheduler->frames, 1, memory_order_relaxed);
+
+    if (session->frame_done != NULL) {
+        session->frame_done(session);
+    }
+
+    // Like the emulator, a session that falls more than a frame behind doesn't try to catch up,
+    // and counts every frame it missed as late
+    uint64_t now = now_nanoseconds();
+    session->deadline += delay;
+    if (now > session->deadline + delay) {
+        atomic_fetch_add_explicit(&scheduler->late_frames, (now - session->deadline) / delay, memory_order_relaxed);
+        session->deadline = now;
+    }
+
+    if (idle(chip)) {
+        // Once it's parked another worker may be running it, so the machine mustn't be touched after
+        uint16_t keys = chip->keys_pressed;
+        atomic_fetch_add(&scheduler->parked, 1);
+        atomic_fetch_add_explicit(&scheduler->parks, 1, memory_order_relaxed);
+        atomic_store(&session->state, SESSION_PARKED);
+
+        // Keys that arrived before we parked would never wake us, so look again.
+        // Whoever moves it out of parked is the one that queues it
+        int parked = SESSION_PARKED;
+        if (atomic_load(&session->keys) != keys &&
+            atomic_compare_exchange_strong(&session->state, &parked, SESSION_QUEUED)) {
+            atomic_fetch_sub(&scheduler->parked, 1);
+            session->deadline = now;
+            push_session(worker, session);
+        }
+        return;
+    }
+
+    push_session(worker, session);
+}
+
+static void *worker_thread(void *arg) {
+    Worker *worker = arg;
+    Scheduler *scheduler = worker->scheduler;
+
+    while (!atomic_load_explicit(&scheduler->stop, memory_order_relaxed)) {
+        uint64_t now = now_nanoseconds();
+
+        pthread_mutex_lock(&worker->lock);
+        Session *session = pop_due(worker, now);
+        pthread_mutex_unlock(&worker->lock);
+
+        if (session == NULL) {
+            session = steal(worker, now);
+        }
+
+        if (session != NULL) {
+            run_session(worker, session);
+            continue;
+        }
+
+        // Sleep until our next deadline, but wake up now and then to look for work to steal
+        pthread_mutex_lock(&worker->lock);
+        uint64_t wake = now + SCHEDULER_MAXIMUM_SLEEP;
+        if (worker->count > 0 && worker->heap[0]->deadline < wake) {
+            wake = worker->heap[0]->deadline;
+        }
+
+        struct timespec until = { wake / NANOSECS_IN_SECOND, wake % NANOSECS_IN_SECOND };
+        if (!atomic_load(&scheduler->stop)) {
+            pthread_cond_timedwait(&worker->wake, &worker->lock, &until);
+        }
+        pthread_mutex_unlock(&worker->lock);
+    }
+
+    return NULL;
+}
+
+static void cleanup_workers(Scheduler *scheduler, int count) {
+    for (int i = 0; i < count; i++) {
+        pthread_mutex_destroy(&scheduler->workers[i].lock);
+        pthread_cond_destroy(&scheduler->workers[i].wake);
+        free(scheduler->workers[i].heap);
+    }
+    free(scheduler->workers);
+    scheduler->workers = NULL;
+}
+
+bool start_scheduler(Scheduler *scheduler, int num_of_workers) {
+    pthread_condattr_t attributes;
+
+    scheduler->num_of_workers = num_of_workers;
+    scheduler->workers = calloc(num_of_workers, sizeof(Worker));
+    if (scheduler->workers == NULL) {
+        printf("Failed to allocate workers\n");
+        return false;
+    }
+
+    atomic_init(&scheduler->stop, false);
+    atomic_init(&scheduler->next_worker, 0);
+    atomic_init(&scheduler->sessions, 0);
+    atomic_init(&scheduler->frames, 0);
+    atomic_init(&scheduler->late_frames, 0);
+    atomic_init(&scheduler->steals, 0);
+    atomic_init(&scheduler->parks, 0);
+    atomic_init(&scheduler->parked, 0);
+
+    // Deadlines come from the monotonic clock, so the waits have to use it too
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+
+    for (int i = 0; i < num_of_workers; i++) {
+        Worker *worker = &scheduler->workers[i];
+        worker->scheduler = scheduler;
+        worker->index = i;
+        worker->count = 0;
+        worker->capacity = SCHEDULER_INITIAL_CAPACITY;
+        worker->heap = malloc(worker->capacity * sizeof(Session *));
+        pthread_mutex_init(&worker->lock, NULL);
+        pthread_cond_init(&worker->wake, &attributes);
+
+        if (worker->heap == NULL) {
+            printf("Failed to allocate workers\n");
+            pthread_condattr_destroy(&attributes);
+            cleanup_workers(scheduler, i + 1);
+            return false;
+        }
+    }
+    pthread_condattr_destroy(&attributes);
+
+    for (int i = 0; i < num_of_workers; i++) {
+        if (pthread_create(&scheduler->workers[i].thread, NULL, worker_thread, &scheduler->workers[i]) != 0) {
+            printf("Failed to start worker %d\n", i);
+            atomic_store(&scheduler->stop, true);
+            for (int j = 0; j < i; j++) {
+                pthread_join(scheduler->workers[j].thread, NULL);
+            }
+            cleanup_workers(scheduler, num_of_workers);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool schedule_session(Scheduler *scheduler, Session *session) {
+    if (!reserve_session(scheduler)) {
+        printf("Failed to allocate room for another session\n");
+        return false;
+    }
+
+    session->deadline = now_nanoseconds();
+    session->frames = 0;
+    atomic_init(&session->keys, 0);
+    atomic_init(&session->state, SESSION_QUEUED);
+
+    push_session(pick_worker(scheduler), session);
+    return true;
+}
+
+void set_session_keys(Scheduler *scheduler, Session *session, uint16_t keys) {
+    atomic_store(&session->keys, keys);
+
+    int parked = SESSION_PARKED;
+    if (atomic_compare_exchange_strong(&session->state, &parked, SESSION_QUEUED)) {
+        atomic_fetch_sub(&scheduler->parked, 1);
+        session->deadline = now_nanoseconds();
+        push_session(pick_worker(scheduler), session);
+    }
+}
+
+void print_scheduler_stats(Scheduler *scheduler, int num_of_sessions) {
+    printf("%d sessions on %d workers: %llu frames, %llu late, %llu stolen, %lld parked now (%llu parks)\n",
+           num_of_sessions, scheduler->num_of_workers, (unsigned long long) atomic_load(&scheduler->frames),
+           (unsigned long long) atomic_load(&scheduler->late_frames), (unsigned long long) atomic_load(&scheduler->steals),
+           (long long) atomic_load(&scheduler->parked), (unsigned long long) atomic_load(&scheduler->parks));
+    fflush(stdout);
+}
+
+void stop_scheduler(Scheduler *scheduler) {
+    atomic_store(&scheduler->stop, true);
+
+    for (int i = 0; i < scheduler->num_of_workers; i++) {
+        Worker *worker = &scheduler->workers[i];
+        pthread_mutex_lock(&worker->lock);
+        pthread_cond_signal(&worker->wake);
+        pthread_mutex_unlock(&worker->lock);
+    }
+
+    for (int i = 0; i < scheduler->num_of_workers; i++) {
+        pthread_join(scheduler->workers[i].thread, NULL);
+    }
+
+    cleanup_workers(scheduler, scheduler->num_of_workers);
+}
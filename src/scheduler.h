@@ -0,0 +1,70 @@
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+#include "structs.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    SESSION_QUEUED,
+    SESSION_RUNNING,
+    // Waiting on FX0A with nothing else to do, it's off every queue until its keys change
+    SESSION_PARKED
+} SessionState;
+
+// One machine paced at 60 frames a second by the scheduler
+typedef struct Session {
+    Chip8 *chip;
+    uint64_t cycles_per_frame;
+    // When its next frame is due
+    uint64_t deadline;
+    uint64_t frames;
+    // Keys held by whatever is driving the session, set with set_session_keys
+    _Atomic uint16_t keys;
+    _Atomic int state;
+    // Called on the worker after every frame, may be NULL
+    void (*frame_done)(struct Session *session);
+    void *user;
+} Session;
+
+struct Scheduler;
+
+// Each worker owns a deadline heap of sessions and steals due ones from the others when it runs dry
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    Session **heap;
+    size_t count;
+    size_t capacity;
+    pthread_t thread;
+    struct Scheduler *scheduler;
+    int index;
+} Worker;
+
+typedef struct Scheduler {
+    Worker *workers;
+    int num_of_workers;
+    _Atomic bool stop;
+    // Round robin for new and woken sessions
+    _Atomic uint32_t next_worker;
+    // Sessions scheduled, every worker's heap has room for this many
+    _Atomic size_t sessions;
+    _Atomic uint64_t frames;
+    _Atomic uint64_t late_frames;
+    _Atomic uint64_t steals;
+    _Atomic uint64_t parks;
+    _Atomic int64_t parked;
+} Scheduler;
+
+bool start_scheduler(Scheduler *scheduler, int num_of_workers);
+// The session must stay put until the scheduler is stopped. Returns false if there's no memory for it
+bool schedule_session(Scheduler *scheduler, Session *session);
+// Wakes the session if it's parked
+void set_session_keys(Scheduler *scheduler, Session *session, uint16_t keys);
+void print_scheduler_stats(Scheduler *scheduler, int num_of_sessions);
+void stop_scheduler(Scheduler *scheduler);
+
+#endif
@@ -0,0 +1,304 @@
+#include "server.h"
+#include "consts.h"
+#include "frame.h"
+#include "io.h"
+#include "ring.h"
+#include "structs.h"
+#include "timing.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static void put_u16(uint8_t *out, uint16_t value) {
+    out[0] = value;
+    out[1] = value >> 8;
+}
+
+static void put_u32(uint8_t *out, uint32_t value) {
+    put_u16(out, value);
+    put_u16(out + 2, value >> 16);
+}
+
+// A socket file left by an instance that died is reused, a live one is left alone
+static bool bind_socket(int fd, struct sockaddr_un const *address) {
+    if (bind(fd, (struct sockaddr const *) address, sizeof(*address)) == 0) {
+        return true;
+    }
+
+    if (errno != EADDRINUSE) {
+        return false;
+    }
+
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    bool alive = probe >= 0 && connect(probe, (struct sockaddr const *) address, sizeof(*address)) == 0;
+    if (probe >= 0) close(probe);
+    if (alive) {
+        errno = EADDRINUSE;
+        return false;
+    }
+
+    unlink(address->sun_path);
+    return bind(fd, (struct sockaddr const *) address, sizeof(*address)) == 0;
+}
+
+bool start_server(Server *server, char const *path) {
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        printf("Socket path %s is too long\n", path);
+        return false;
+    }
+    strcpy(address.sun_path, path);
+
+    server->path = path;
+    server->num_of_clients = 0;
+    server->orphaned_keys = 0;
+    server->listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (server->listener < 0) {
+        printf("Failed to create socket: %s\n", strerror(errno));
+        return false;
+    }
+
+    if (!bind_socket(server->listener, &address) || listen(server->listener, SERVER_MAX_CLIENTS) != 0) {
+        printf("Failed to listen on %s: %s\n", path, strerror(errno));
+        close(server->listener);
+        return false;
+    }
+
+    return true;
+}
+
+static void drop_client(Server *server, int index) {
+    Client *client = &server->clients[index];
+
+    close(client->fd);
+    free(client->output);
+    server->orphaned_keys |= client->held_keys;
+
+    // Keep the clients packed, the order doesn't matter
+    server->num_of_clients--;
+    if (index != server->num_of_clients) {
+        memcpy(client, &server->clients[server->num_of_clients], sizeof(Client));
+    }
+}
+
+static void accept_clients(Server *server) {
+    int fd;
+
+    while ((fd = accept(server->listener, NULL, NULL)) >= 0) {
+        if (server->num_of_clients == SERVER_MAX_CLIENTS || fcntl(fd, F_SETFL, O_NONBLOCK) != 0) {
+            printf("Turned away a client\n");
+            close(fd);
+            continue;
+        }
+
+        Client *client = &server->clients[server->num_of_clients];
+        client->output = malloc(SERVER_OUTPUT_BUFFER_SIZE);
+        if (client->output == NULL) {
+            close(fd);
+            continue;
+        }
+
+        client->fd = fd;
+        client->output_used = 0;
+        client->input_used = 0;
+        client->held_keys = 0;
+        client->frames_since_keyframe = 0;
+        server->num_of_clients++;
+    }
+}
+
+// Returns false once the client has gone
+static bool read_keys(Client *client, RingBuffer *key_events) {
+    uint8_t buffer[64];
+    ssize_t received;
+
+    while ((received = recv(client->fd, buffer, sizeof(buffer), 0)) > 0) {
+        for (ssize_t i = 0; i < received; i++) {
+            client->input[client->input_used++] = buffer[i];
+            if (client->input_used < sizeof(client->input)) continue;
+            client->input_used = 0;
+
+            uint8_t type = client->input[0];
+            uint8_t key = client->input[1];
+            if (key >= NUM_OF_KEYS || (type != SERVER_KEY_PRESS && type != SERVER_KEY_RELEASE)) continue;
+
+            KeyEvent event = { now_nanoseconds(), 1 << key, type == SERVER_KEY_PRESS };
+            if (event.pressed) {
+                client->held_keys |= event.mask;
+            } else {
+                client->held_keys &= ~event.mask;
+            }
+
+            queue_key_event(key_events, &event);
+        }
+    }
+
+    return received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+}
+
+// Returns false if the client has gone
+static bool flush_client(Client *client) {
+    size_t sent = 0;
+
+    while (sent < client->output_used) {
+        ssize_t written = send(client->fd, client->output + sent, client->output_used - sent, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) return false;
+            break;
+        }
+        sent += written;
+    }
+
+    memmove(client->output, client->output + sent, client->output_used - sent);
+    client->output_used -= sent;
+    return true;
+}
+
+// Let go of whatever clients that have gone were holding
+static void release_orphaned_keys(Server *server, RingBuffer *key_events) {
+    if (server->orphaned_keys == 0) {
+        return;
+    }
+
+    KeyEvent event = { now_nanoseconds(), server->orphaned_keys, false };
+    queue_key_event(key_events, &event);
+    server->orphaned_keys = 0;
+}
+
+void poll_server(Server *server, RingBuffer *key_events, int timeout) {
+    struct pollfd fds[SERVER_MAX_CLIENTS + 1];
+
+    // Releases that didn't fit last time, and clients dropped by broadcast_frame since the last poll
+    flush_key_releases(key_events);
+    release_orphaned_keys(server, key_events);
+
+    fds[0].fd = server->listener;
+    fds[0].events = POLLIN;
+    for (int i = 0; i < server->num_of_clients; i++) {
+        fds[i + 1].fd = server->clients[i].fd;
+        fds[i + 1].events = POLLIN | (server->clients[i].output_used > 0 ? POLLOUT : 0);
+    }
+
+    int clients = server->num_of_clients;
+    if (poll(fds, clients + 1, timeout) <= 0) {
+        return;
+    }
+
+    // Backwards so dropping a client doesn't move one we haven't looked at yet
+    for (int i = clients - 1; i >= 0; i--) {
+        short events = fds[i + 1].revents;
+        bool alive = !(events & (POLLERR | POLLNVAL));
+
+        if (alive && (events & (POLLIN | POLLHUP))) {
+            alive = read_keys(&server->clients[i], key_events);
+        }
+        if (alive && (events & POLLOUT)) {
+            alive = flush_client(&server->clients[i]);
+        }
+
+        if (!alive) {
+            drop_client(server, i);
+        }
+    }
+
+    release_orphaned_keys(server, key_events);
+
+    if (fds[0].revents & POLLIN) {
+        accept_clients(server);
+    }
+}
+
+static void encode_row(uint8_t *out, int plane, int y, uint64_t const *words) {
+    out[0] = plane;
+    out[1] = y;
+    for (int w = 0; w < SCREEN_ROW_WORDS; w++) {
+        for (int b = 0; b < 8; b++) {
+            out[2 + w * 8 + b] = words[w] >> (56 - b * 8);
+        }
+    }
+}
+
+// Returns false if the message doesn't fit in what's left of the output buffer
+static bool encode_frame(Client *client, Frame const *frame) {
+    int height = frame->hires ? HIRES_SCREEN_HEIGHT : SCREEN_HEIGHT;
+    bool keyframe = client->frames_since_keyframe == 0 || client->frames_since_keyframe >= SERVER_KEYFRAME_INTERVAL ||
+                    client->hires != frame->hires || client->planes != frame->planes ||
+                    memcmp(client->colours, frame->colours, sizeof(client->colours)) != 0;
+    size_t largest = SERVER_HEADER_SIZE + sizeof(client->colours) + frame->planes * height * SERVER_ROW_SIZE;
+
+    if (SERVER_OUTPUT_BUFFER_SIZE - client->output_used < largest) {
+        return false;
+    }
+
+    uint8_t *header = client->output + client->output_used;
+    uint8_t *out = header + SERVER_HEADER_SIZE;
+    uint16_t rows = 0;
+
+    if (keyframe) {
+        for (int i = 0; i < NUM_OF_COLOURS; i++) {
+            put_u32(out, frame->colours[i]);
+            out += 4;
+        }
+    }
+
+    for (int plane = 0; plane < frame->planes; plane++) {
+        for (int y = 0; y < height; y++) {
+            uint64_t const *row = frame->screen[plane][y];
+            if (!keyframe && memcmp(row, client->screen[plane][y], sizeof(client->screen[plane][y])) == 0) continue;
+
+            encode_row(out, plane, y, row);
+            memcpy(client->screen[plane][y], row, sizeof(client->screen[plane][y]));
+            out += SERVER_ROW_SIZE;
+            rows++;
+        }
+    }
+
+    header[0] = keyframe ? SERVER_KEYFRAME : SERVER_DELTA;
+    header[1] = frame->hires;
+    header[2] = frame->planes;
+    header[3] = 0;
+    put_u32(header + 4, frame->number);
+    put_u16(header + 8, rows);
+    put_u16(header + 10, 0);
+
+    client->output_used = out - client->output;
+    client->frames_since_keyframe = keyframe ? 1 : client->frames_since_keyframe + 1;
+    client->hires = frame->hires;
+    client->planes = frame->planes;
+    memcpy(client->colours, frame->colours, sizeof(client->colours));
+
+    return true;
+}
+
+void broadcast_frame(Server *server, Frame const *frame) {
+    for (int i = server->num_of_clients - 1; i >= 0; i--) {
+        Client *client = &server->clients[i];
+
+        // Every client's messages for the frame go out in one send
+        if (!encode_frame(client, frame)) {
+            printf("Dropped a client that stopped reading\n");
+            drop_client(server, i);
+        } else if (!flush_client(client)) {
+            drop_client(server, i);
+        }
+    }
+}
+
+void stop_server(Server *server) {
+    while (server->num_of_clients > 0) {
+        drop_client(server, server->num_of_clients - 1);
+    }
+
+    close(server->listener);
+    unlink(server->path);
+}
@@ -0,0 +1,57 @@
+#ifndef SERVER_H_
+#define SERVER_H_
+
+#include "consts.h"
+#include "frame.h"
+#include "ring.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Streams frames to clients on a Unix domain socket and takes key presses back.
+//
+// Every frame is a message, numbers are little endian:
+//   u8 type (SERVER_KEYFRAME or SERVER_DELTA), u8 hires, u8 planes, u8 0, u32 frame number,
+//   u16 row count, u16 0, then keyframes only: 4 x u32 RGBA colours, then the rows.
+// Each row is u8 plane, u8 y and the row's 128 pixels as 16 bytes, the first byte's top bit leftmost.
+// Keyframes hold every row, deltas only the rows that changed since the last message,
+// so an unchanged screen costs a bare header.
+//
+// Clients send two byte messages, u8 SERVER_KEY_PRESS or SERVER_KEY_RELEASE and u8 key (0-F)
+
+typedef struct {
+    int fd;
+    // Encoded messages waiting for the socket to take them
+    uint8_t *output;
+    size_t output_used;
+    // Part of a key message
+    uint8_t input[2];
+    size_t input_used;
+    // Keys the client is holding down, released for it if it goes away
+    uint16_t held_keys;
+    // What the client has been sent, deltas are against this
+    uint64_t screen[NUM_OF_PLANES][HIRES_SCREEN_HEIGHT][SCREEN_ROW_WORDS];
+    uint32_t colours[NUM_OF_COLOURS];
+    uint8_t planes;
+    bool hires;
+    // 0 until the first keyframe has been sent
+    uint32_t frames_since_keyframe;
+} Client;
+
+typedef struct {
+    int listener;
+    char const *path;
+    Client clients[SERVER_MAX_CLIENTS];
+    int num_of_clients;
+    // Keys held by clients that have gone, queued as releases by the next poll_server
+    uint16_t orphaned_keys;
+} Server;
+
+bool start_server(Server *server, char const *path);
+// Accepts clients and queues their key presses, waiting up to timeout milliseconds for any activity
+void poll_server(Server *server, RingBuffer *key_events, int timeout);
+// Clients too slow to keep up are disconnected rather than waited on, the keys they held are released by the next poll
+void broadcast_frame(Server *server, Frame const *frame);
+void stop_server(Server *server);
+
+#endif
@@ -0,0 +1,108 @@
+#include "shm.h"
+#include "consts.h"
+#include "frame.h"
+#include <fcntl.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define READ_ATTEMPTS 16
+
+// shm_open wants exactly one leading slash
+static void segment_name(char const *name, char *out, size_t size) {
+    snprintf(out, size, "%s%s", name[0] == '/' ? "" : "/", name);
+}
+
+SharedFrame *create_shared_frame(char const *name) {
+    char path[NAME_MAX];
+    segment_name(name, path, sizeof(path));
+
+    int fd = shm_open(path, O_CREAT | O_RDWR, 0600);
+    if (fd < 0) {
+        printf("Failed to open shared memory %s\n", path);
+        return NULL;
+    }
+
+    if (ftruncate(fd, sizeof(SharedFrame)) != 0) {
+        printf("Failed to size shared memory %s\n", path);
+        close(fd);
+        shm_unlink(path);
+        return NULL;
+    }
+
+    SharedFrame *shared = mmap(NULL, sizeof(SharedFrame), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shared == MAP_FAILED) {
+        printf("Failed to map shared memory %s\n", path);
+        shm_unlink(path);
+        return NULL;
+    }
+
+    memset(shared, 0, sizeof(SharedFrame));
+    shared->version = SHARED_FRAME_VERSION;
+    atomic_store(&shared->latest, 0);
+    atomic_store(&shared->keys, 0);
+    // Readers check the magic last, so it only appears once the rest is ready
+    atomic_thread_fence(memory_order_release);
+    shared->magic = SHARED_FRAME_MAGIC;
+
+    return shared;
+}
+
+void publish_shared_frame(SharedFrame *shared, Frame const *frame) {
+    uint32_t index = atomic_load_explicit(&shared->latest, memory_order_relaxed) ^ 1;
+    SharedScreen *screen = &shared->screens[index];
+    uint32_t sequence = atomic_load_explicit(&screen->sequence, memory_order_relaxed);
+
+    atomic_store_explicit(&screen->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    screen->number = frame->number;
+    screen->planes = frame->planes;
+    screen->hires = frame->hires;
+    memcpy(screen->colours, frame->colours, sizeof(screen->colours));
+    memcpy(screen->screen, frame->screen, frame->planes * sizeof(screen->screen[0]));
+
+    atomic_store_explicit(&screen->sequence, sequence + 2, memory_order_release);
+    atomic_store_explicit(&shared->latest, index, memory_order_release);
+}
+
+bool read_shared_frame(SharedFrame const *shared, Frame *frame) {
+    for (int attempt = 0; attempt < READ_ATTEMPTS; attempt++) {
+        uint32_t index = atomic_load_explicit(&shared->latest, memory_order_acquire);
+        SharedScreen const *screen = &shared->screens[index];
+
+        uint32_t before = atomic_load_explicit(&screen->sequence, memory_order_acquire);
+        if (before & 1) continue;
+
+        frame->number = screen->number;
+        frame->planes = screen->planes > NUM_OF_PLANES ? NUM_OF_PLANES : screen->planes;
+        frame->hires = screen->hires;
+        memcpy(frame->colours, screen->colours, sizeof(frame->colours));
+        memcpy(frame->screen, screen->screen, frame->planes * sizeof(frame->screen[0]));
+
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&screen->sequence, memory_order_relaxed) == before) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+uint16_t shared_keys(SharedFrame const *shared) {
+    return atomic_load_explicit(&shared->keys, memory_order_relaxed);
+}
+
+void cleanup_shared_frame(SharedFrame *shared, char const *name) {
+    char path[NAME_MAX];
+    segment_name(name, path, sizeof(path));
+
+    munmap(shared, sizeof(SharedFrame));
+    shm_unlink(path);
+}
@@ -0,0 +1,41 @@
+#ifndef SHM_H_
+#define SHM_H_
+
+#include "consts.h"
+#include "frame.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// One of the two screens in the segment. sequence is odd while the emulator is writing it
+typedef struct {
+    _Atomic uint32_t sequence;
+    uint8_t planes;
+    bool hires;
+    uint64_t number;
+    uint32_t colours[NUM_OF_COLOURS];
+    uint64_t screen[NUM_OF_PLANES][HIRES_SCREEN_HEIGHT][SCREEN_ROW_WORDS];
+} SharedScreen;
+
+// Layout of the POSIX shared memory segment made by --shm.
+// The emulator writes whichever screen isn't latest and then flips latest, so readers can
+// use the latest screen in place and only retry if it was rewritten while they read it.
+// Consumers set keys to the CHIP-8 keys they're holding, which the emulator merges with its own
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    _Atomic uint32_t latest;
+    _Atomic uint16_t keys;
+    SharedScreen screens[2];
+} SharedFrame;
+
+// name is a POSIX shared memory name, a leading / is added if it's missing
+SharedFrame *create_shared_frame(char const *name);
+void publish_shared_frame(SharedFrame *shared, Frame const *frame);
+// For consumers, copies the newest screen out. Returns false if the emulator kept rewriting it
+bool read_shared_frame(SharedFrame const *shared, Frame *frame);
+uint16_t shared_keys(SharedFrame const *shared);
+// Unmaps and removes the segment
+void cleanup_shared_frame(SharedFrame *shared, char const *name);
+
+#endif
@@ -0,0 +1,114 @@
+#include "stats.h"
+#include "consts.h"
+#include "timing.h"
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Values below HISTOGRAM_SUB_BUCKETS get a bucket each, above that every power of two
+// is split into HISTOGRAM_SUB_BUCKETS equal steps
+static int bucket_index(uint64_t value) {
+    if (value < HISTOGRAM_SUB_BUCKETS) {
+        return value;
+    }
+
+    int exponent = 63 - __builtin_clzll(value);
+    int shift = exponent - HISTOGRAM_SUB_BUCKET_BITS;
+    int step = (value >> shift) - HISTOGRAM_SUB_BUCKETS;
+
+    return (shift + 1) * HISTOGRAM_SUB_BUCKETS + step;
+}
+
+// Largest value that lands in the bucket
+static uint64_t bucket_value(int index) {
+    if (index < HISTOGRAM_SUB_BUCKETS) {
+        return index;
+    }
+
+    int shift = index / HISTOGRAM_SUB_BUCKETS - 1;
+    uint64_t step = index % HISTOGRAM_SUB_BUCKETS + HISTOGRAM_SUB_BUCKETS;
+
+    return (step << shift) + ((1ULL << shift) - 1);
+}
+
+static void init_histogram(Histogram *histogram) {
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        atomic_init(&histogram->buckets[i], 0);
+    }
+    atomic_init(&histogram->count, 0);
+    atomic_init(&histogram->total, 0);
+    atomic_init(&histogram->max, 0);
+}
+
+void init_stats(Stats *stats) {
+    init_histogram(&stats->emulation);
+    init_histogram(&stats->present);
+    init_histogram(&stats->input_latency);
+    atomic_init(&stats->frames, 0);
+    atomic_init(&stats->cycles, 0);
+    atomic_init(&stats->dropped_frames, 0);
+    atomic_init(&stats->late_frames, 0);
+    stats->started = now_nanoseconds();
+}
+
+void record_value(Histogram *histogram, uint64_t value) {
+    atomic_fetch_add_explicit(&histogram->buckets[bucket_index(value)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&histogram->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&histogram->total, value, memory_order_relaxed);
+
+    uint64_t max = atomic_load_explicit(&histogram->max, memory_order_relaxed);
+    while (value > max && !atomic_compare_exchange_weak_explicit(&histogram->max, &max, value,
+                                                                 memory_order_relaxed, memory_order_relaxed)) {}
+}
+
+uint64_t histogram_percentile(Histogram const *histogram, double fraction) {
+    uint64_t count = atomic_load_explicit(&histogram->count, memory_order_relaxed);
+    uint64_t max = atomic_load_explicit(&histogram->max, memory_order_relaxed);
+    uint64_t target = fraction * count;
+    uint64_t seen = 0;
+
+    if (target < 1) target = 1;
+
+    // The count may run ahead of the buckets while recording, fall back to the max
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += atomic_load_explicit(&histogram->buckets[i], memory_order_relaxed);
+        if (seen >= target) {
+            uint64_t value = bucket_value(i);
+            return value < max ? value : max;
+        }
+    }
+
+    return max;
+}
+
+static void print_histogram(Histogram const *histogram, char const *name) {
+    uint64_t count = atomic_load_explicit(&histogram->count, memory_order_relaxed);
+    uint64_t total = atomic_load_explicit(&histogram->total, memory_order_relaxed);
+    double scale = NANOSECS_IN_MICROSECONDS;
+
+    if (count == 0) {
+        printf("  %-14s %10d\n", name, 0);
+        return;
+    }
+
+    printf("  %-14s %10llu %10.1f %10.1f %10.1f %10.1f %10.1f\n", name, (unsigned long long) count, total / scale / count,
+           histogram_percentile(histogram, 0.5) / scale, histogram_percentile(histogram, 0.99) / scale,
+           histogram_percentile(histogram, 0.999) / scale,
+           atomic_load_explicit(&histogram->max, memory_order_relaxed) / scale);
+}
+
+void print_stats(Stats const *stats, char const *name) {
+    uint64_t frames = atomic_load_explicit(&stats->frames, memory_order_relaxed);
+    uint64_t cycles = atomic_load_explicit(&stats->cycles, memory_order_relaxed);
+    double seconds = (double) (now_nanoseconds() - stats->started) / NANOSECS_IN_SECOND;
+
+    printf("%s: %llu frames in %.1fs, %.1f frames/s, %.0f cycles/s, %llu dropped, %llu late\n", name,
+           (unsigned long long) frames, seconds, frames / seconds, cycles / seconds,
+           (unsigned long long) atomic_load_explicit(&stats->dropped_frames, memory_order_relaxed),
+           (unsigned long long) atomic_load_explicit(&stats->late_frames, memory_order_relaxed));
+    printf("  %-14s %10s %10s %10s %10s %10s %10s\n", "(microseconds)", "count", "mean", "p50", "p99", "p99.9", "max");
+    print_histogram(&stats->emulation, "emulation");
+    print_histogram(&stats->present, "present");
+    print_histogram(&stats->input_latency, "input latency");
+    fflush(stdout);
+}
@@ -0,0 +1,39 @@
+#ifndef STATS_H_
+#define STATS_H_
+
+#include "consts.h"
+#include <stdatomic.h>
+#include <stdint.h>
+
+// Log linear histogram of nanosecond values, accurate to 1/HISTOGRAM_SUB_BUCKETS of the value.
+// Recording is a few relaxed atomic adds so any thread can read it while another records
+typedef struct {
+    _Atomic uint64_t buckets[HISTOGRAM_BUCKETS];
+    _Atomic uint64_t count;
+    _Atomic uint64_t total;
+    _Atomic uint64_t max;
+} Histogram;
+
+typedef struct {
+    // Time spent running cycles each frame, not counting the sleeps between input batches
+    Histogram emulation;
+    // Time spent in update_display
+    Histogram present;
+    // From the host seeing a key change to the first frame that ran with it being published
+    Histogram input_latency;
+    _Atomic uint64_t frames;
+    _Atomic uint64_t cycles;
+    // Published frames the display never showed
+    _Atomic uint64_t dropped_frames;
+    // Frames that ran so late the emulation gave up catching up
+    _Atomic uint64_t late_frames;
+    uint64_t started;
+} Stats;
+
+void init_stats(Stats *stats);
+void record_value(Histogram *histogram, uint64_t value);
+// Smallest value at least fraction of the recorded values are at or below, to the histogram's accuracy
+uint64_t histogram_percentile(Histogram const *histogram, double fraction);
+void print_stats(Stats const *stats, char const *name);
+
+#endif
@@ -12,10 +12,25 @@ typedef struct {
     bool breakpoints[NUM_OF_INSTRUCTIONS];
 } Debugger;
 
+// Behaviour that differs between interpreters, the profiles are in chip8.c
 typedef struct {
+    // 8XY1, 8XY2 and 8XY3 reset VF
+    bool vf_reset;
+    // 8XY6 and 8XYE shift VY rather than VX
+    bool shift_vy;
+    // FX55 and FX65 leave I after the last register
+    bool memory_increment;
+    // Drawing waits for the display interrupt
+    bool display_wait;
+    // Sprites are cut off at the edge of the screen rather than wrapping
+    bool clip;
+    // BNNN jumps to XNN + VX
+    bool jump_vx;
+} Quirks;
+
+typedef struct Chip8 {
     uint8_t delay_timer;
     uint8_t sound_timer;
-    uint8_t memory[4096];
     uint8_t registers[NUM_OF_REGISTERS];
     uint8_t stack_pointer;
     uint8_t waiting_to_draw;
@@ -24,15 +39,48 @@ typedef struct {
     uint16_t stack[MAX_STACK_SIZE];
     uint16_t keys_pressed;
     uint16_t keys_snapshot;
-    uint32_t screen[SCREEN_SIZE];
+    // Stuck on FX0A, nothing happens until keys_pressed changes
+    bool waiting_for_key;
+    // One bit per pixel, the most significant bit of each row word is the leftmost pixel.
+    // Low resolution only uses the top left SCREEN_WIDTH x SCREEN_HEIGHT
+    uint64_t screen[NUM_OF_PLANES][HIRES_SCREEN_HEIGHT][SCREEN_ROW_WORDS];
+    // Bit mask of the planes drawing and scrolling apply to (XO-CHIP)
+    uint8_t planes;
+    uint8_t rpl_flags[NUM_OF_RPL_FLAGS];
+    uint8_t mode;
+    uint8_t quirks;
+    // Interpreter specialised for the quirk profile, picked once by init_chip8
+    void (*execute)(struct Chip8 *chip);
+    bool hires;
+    // Audio pattern buffer and pitch register (XO-CHIP)
+    uint8_t audio_pattern[AUDIO_PATTERN_SIZE];
+    uint8_t pitch;
+    bool audio_pattern_loaded;
     uint32_t foreground_colour;
     uint32_t background_colour;
     bool display_interrupt_triggered;
+    uint32_t random_state;
+    // Fingerprint of the loaded ROM, used to look it up in the ROM database
+    uint64_t rom_hash;
 
     // Debugger, is null if debugging disabled
     Debugger *debugger;
+
+    // One bit per DIRTY_PAGE_SIZE bytes of memory written since the last reset
+    uint64_t dirty_pages;
+
+    // Sized for the mode by create_chip8, keep this last
+    uint32_t memory_size;
+    uint8_t memory[];
 } Chip8;
 
+typedef struct {
+    // When the host saw the key change, from now_nanoseconds()
+    uint64_t timestamp;
+    uint16_t mask;
+    bool pressed;
+} KeyEvent;
+
 typedef struct {
     uint8_t instruction;
     uint8_t x;
@@ -0,0 +1,19 @@
+#include "timing.h"
+#include "consts.h"
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+
+uint64_t now_nanoseconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * NANOSECS_IN_SECOND + now.tv_nsec;
+}
+
+void sleep_until_nanoseconds(uint64_t deadline) {
+    struct timespec until = { deadline / NANOSECS_IN_SECOND, deadline % NANOSECS_IN_SECOND };
+
+    // Absolute deadlines don't drift when we wake up late
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL) == EINTR) {}
+}
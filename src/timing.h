@@ -0,0 +1,10 @@
+#ifndef TIMING_H_
+#define TIMING_H_
+
+#include <stdint.h>
+
+// Monotonic clock in nanoseconds, shared by every thread so timestamps can be compared
+uint64_t now_nanoseconds();
+void sleep_until_nanoseconds(uint64_t deadline);
+
+#endif
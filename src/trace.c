@@ -0,0 +1,125 @@
+#include "trace.h"
+#include "consts.h"
+#include "ring.h"
+#include "timing.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+static char const *PHASE_NAMES[NUM_OF_TRACE_PHASES] = {
+    [TRACE_POLL] = "poll input",
+    [TRACE_TIMERS] = "timers",
+    [TRACE_CYCLES] = "cycles",
+    [TRACE_DISPLAY_WAIT] = "display wait",
+    [TRACE_PRESENT] = "present",
+};
+
+static char const *THREAD_NAMES[NUM_OF_TRACE_THREADS] = {
+    [TRACE_MAIN_THREAD] = "main",
+    [TRACE_EMULATION_THREAD] = "emulation",
+};
+
+static void write_event(Tracer *tracer, TraceThread thread, TraceEvent const *event) {
+    // Chrome wants microseconds, keep the nanoseconds as the fraction
+    fprintf(tracer->file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+            PHASE_NAMES[event->phase], thread + 1, (event->start - tracer->origin) / 1000.0,
+            (event->end - event->start) / 1000.0);
+}
+
+// Returns the number of events written
+static int drain(Tracer *tracer) {
+    TraceEvent event;
+    int written = 0;
+
+    for (int thread = 0; thread < NUM_OF_TRACE_THREADS; thread++) {
+        while (ring_pop(&tracer->events[thread], &event)) {
+            write_event(tracer, thread, &event);
+            written++;
+        }
+    }
+
+    return written;
+}
+
+static void *writer_thread(void *arg) {
+    Tracer *tracer = arg;
+
+    while (!atomic_load(&tracer->stop)) {
+        if (drain(tracer) == 0) {
+            sleep_until_nanoseconds(now_nanoseconds() + TRACE_FLUSH_NANOSECONDS);
+        }
+    }
+
+    drain(tracer);
+    return NULL;
+}
+
+bool start_trace(Tracer *tracer, char const *path) {
+    tracer->file = fopen(path, "w");
+    if (tracer->file == NULL) {
+        printf("Failed to open trace file %s\n", path);
+        return false;
+    }
+
+    for (int thread = 0; thread < NUM_OF_TRACE_THREADS; thread++) {
+        if (!init_ring_buffer(&tracer->events[thread], TRACE_EVENT_CAPACITY, sizeof(TraceEvent))) {
+            printf("Failed to allocate trace buffers\n");
+            for (int i = 0; i < thread; i++) {
+                cleanup_ring_buffer(&tracer->events[i]);
+            }
+            fclose(tracer->file);
+            return false;
+        }
+    }
+
+    atomic_init(&tracer->dropped, 0);
+    atomic_init(&tracer->stop, false);
+    tracer->origin = now_nanoseconds();
+
+    // The thread names go first, every event after them starts with a comma
+    fprintf(tracer->file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(tracer->file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"chip8\"}}");
+    for (int thread = 0; thread < NUM_OF_TRACE_THREADS; thread++) {
+        fprintf(tracer->file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                thread + 1, THREAD_NAMES[thread]);
+    }
+
+    if (pthread_create(&tracer->writer, NULL, writer_thread, tracer) != 0) {
+        printf("Failed to start trace writer\n");
+        for (int thread = 0; thread < NUM_OF_TRACE_THREADS; thread++) {
+            cleanup_ring_buffer(&tracer->events[thread]);
+        }
+        fclose(tracer->file);
+        return false;
+    }
+
+    return true;
+}
+
+void trace_event(Tracer *tracer, TraceThread thread, TracePhase phase, uint64_t start, uint64_t end) {
+    if (tracer == NULL) return;
+
+    TraceEvent event = { start, end, phase };
+    if (!ring_push(&tracer->events[thread], &event)) {
+        atomic_fetch_add_explicit(&tracer->dropped, 1, memory_order_relaxed);
+    }
+}
+
+void stop_trace(Tracer *tracer) {
+    atomic_store(&tracer->stop, true);
+    pthread_join(tracer->writer, NULL);
+
+    fprintf(tracer->file, "\n]}\n");
+    fclose(tracer->file);
+
+    uint64_t dropped = atomic_load(&tracer->dropped);
+    if (dropped > 0) {
+        printf("Trace dropped %llu events, the writer couldn't keep up\n", (unsigned long long) dropped);
+    }
+
+    for (int thread = 0; thread < NUM_OF_TRACE_THREADS; thread++) {
+        cleanup_ring_buffer(&tracer->events[thread]);
+    }
+}
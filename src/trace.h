@@ -0,0 +1,53 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include "ring.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Threads that record events, each has its own queue so recording never takes a lock
+typedef enum {
+    TRACE_MAIN_THREAD,
+    TRACE_EMULATION_THREAD,
+    NUM_OF_TRACE_THREADS
+} TraceThread;
+
+// Frame phases, names are in trace.c
+typedef enum {
+    TRACE_POLL,
+    TRACE_TIMERS,
+    TRACE_CYCLES,
+    TRACE_DISPLAY_WAIT,
+    TRACE_PRESENT,
+    NUM_OF_TRACE_PHASES
+} TracePhase;
+
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+    uint8_t phase;
+} TraceEvent;
+
+// Writes Chrome trace event JSON, which Perfetto and chrome://tracing both open.
+// Events are queued in memory and written out by a thread of its own
+typedef struct {
+    FILE *file;
+    RingBuffer events[NUM_OF_TRACE_THREADS];
+    // Events lost because a queue was full
+    _Atomic uint64_t dropped;
+    _Atomic bool stop;
+    pthread_t writer;
+    // Timestamps are written relative to this
+    uint64_t origin;
+} Tracer;
+
+bool start_trace(Tracer *tracer, char const *path);
+// Does nothing when tracer is NULL
+void trace_event(Tracer *tracer, TraceThread thread, TracePhase phase, uint64_t start, uint64_t end);
+// Writes out everything still queued and closes the file
+void stop_trace(Tracer *tracer);
+
+#endif
@@ -0,0 +1,249 @@
+#include "tty.h"
+#include "consts.h"
+#include "frame.h"
+#include "io.h"
+#include "ring.h"
+#include "structs.h"
+#include "timing.h"
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#define TTY_UNDRAWN 0xFF
+#define CTRL_C 0x03
+#define ESCAPE 0x1B
+
+// Upper half block, the top pixel is the foreground and the bottom one the background
+static char const UPPER_HALF[] = "\xE2\x96\x80";
+
+static void emit(Tty *tty, char const *format, ...) {
+    va_list args;
+    size_t space = TTY_OUTPUT_BUFFER_SIZE - tty->output_used;
+
+    va_start(args, format);
+    int length = vsnprintf(tty->output + tty->output_used, space, format, args);
+    va_end(args);
+
+    if (length > 0 && (size_t) length < space) {
+        tty->output_used += length;
+    }
+}
+
+static void flush_tty(Tty *tty) {
+    size_t sent = 0;
+
+    while (sent < tty->output_used) {
+        ssize_t written = write(STDOUT_FILENO, tty->output + sent, tty->output_used - sent);
+        if (written <= 0) break;
+        sent += written;
+    }
+
+    tty->output_used = 0;
+}
+
+static void forget_cells(Tty *tty) {
+    memset(tty->cells, TTY_UNDRAWN, sizeof(tty->cells));
+    tty->foreground = -1;
+    tty->background = -1;
+}
+
+bool init_tty(Tty *tty) {
+    if (!isatty(STDIN_FILENO) || !isatty(STDOUT_FILENO) || tcgetattr(STDIN_FILENO, &tty->original) != 0) {
+        printf("--tty needs a terminal\n");
+        return false;
+    }
+
+    tty->output = malloc(TTY_OUTPUT_BUFFER_SIZE);
+    if (tty->output == NULL) {
+        printf("Failed to allocate terminal output buffer\n");
+        return false;
+    }
+
+    // No echo, no line buffering and reads that never wait
+    struct termios raw = tty->original;
+    cfmakeraw(&raw);
+    raw.c_oflag |= OPOST | ONLCR;
+    raw.c_cc[VMIN] = 0;
+    raw.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw);
+
+    tty->output_used = 0;
+    tty->hires = false;
+    memset(tty->colours, 0, sizeof(tty->colours));
+    memset(tty->held, 0, sizeof(tty->held));
+    memset(tty->repeating, 0, sizeof(tty->repeating));
+    forget_cells(tty);
+
+    // Alternate screen, hidden cursor, cleared
+    emit(tty, "\x1B[?1049h\x1B[?25l\x1B[2J");
+    flush_tty(tty);
+
+    return true;
+}
+
+static void set_colour(Tty *tty, bool foreground, int index) {
+    uint32_t colour = tty->colours[index];
+
+    emit(tty, "\x1B[%d;2;%u;%u;%um", foreground ? 38 : 48, colour >> 24, (colour >> 16) & 0xFF, (colour >> 8) & 0xFF);
+    if (foreground) {
+        tty->foreground = index;
+    } else {
+        tty->background = index;
+    }
+}
+
+static int pixel(Frame const *frame, int x, int y) {
+    int word = x / ROW_WORD_BITS;
+    int bit = 63 - x % ROW_WORD_BITS;
+    int index = (frame->screen[0][y][word] >> bit) & 1;
+
+    if (frame->planes > 1) {
+        index |= ((frame->screen[1][y][word] >> bit) & 1) << 1;
+    }
+
+    return index;
+}
+
+void update_tty(Tty *tty, Frame const *frame) {
+    int width = frame->hires ? HIRES_SCREEN_WIDTH : SCREEN_WIDTH;
+    int rows = (frame->hires ? HIRES_SCREEN_HEIGHT : SCREEN_HEIGHT) / 2;
+    // Where the terminal cursor is after the last cell we wrote, -1 if we don't know
+    int cursor_row = -1;
+    int cursor_column = -1;
+
+    // Different resolution or colours mean every cell has to be redrawn
+    if (frame->hires != tty->hires || memcmp(frame->colours, tty->colours, sizeof(tty->colours)) != 0) {
+        tty->hires = frame->hires;
+        memcpy(tty->colours, frame->colours, sizeof(tty->colours));
+        forget_cells(tty);
+        emit(tty, "\x1B[0m\x1B[2J");
+    }
+
+    for (int row = 0; row < rows; row++) {
+        for (int x = 0; x < width; x++) {
+            int top = pixel(frame, x, row * 2);
+            int bottom = pixel(frame, x, row * 2 + 1);
+            uint8_t cell = top | bottom << 2;
+
+            if (tty->cells[row][x] == cell) continue;
+            tty->cells[row][x] = cell;
+
+            // Writing a cell moves the cursor along, so runs of changes only need one move
+            if (row != cursor_row || x != cursor_column) {
+                emit(tty, "\x1B[%d;%dH", row + 1, x + 1);
+            }
+
+            if (top == bottom) {
+                if (tty->background != top) set_colour(tty, false, top);
+                emit(tty, " ");
+            } else {
+                if (tty->foreground != top) set_colour(tty, true, top);
+                if (tty->background != bottom) set_colour(tty, false, bottom);
+                emit(tty, "%s", UPPER_HALF);
+            }
+
+            cursor_row = row;
+            cursor_column = x + 1;
+        }
+    }
+
+    flush_tty(tty);
+}
+
+static void queue_key(RingBuffer *key_events, uint64_t now, int key, bool pressed) {
+    KeyEvent event = { now, 1 << key, pressed };
+    queue_key_event(key_events, &event);
+}
+
+// Index of the last byte of the escape sequence starting at start, or start if the escape is on its own.
+// Arrows and function keys are CSI (ESC [ parameters final) or SS3 (ESC O final), anything else after
+// an escape is Alt with that key. A sequence cut off by the end of the read is dropped
+static ssize_t escape_sequence_end(uint8_t const *buffer, ssize_t start, ssize_t received) {
+    ssize_t i = start + 1;
+    if (i == received || buffer[i] == ESCAPE) {
+        return start;
+    }
+
+    if (buffer[i] == '[') {
+        // Parameter and intermediate bytes run until the final byte, 0x40 to 0x7E
+        for (i++; i < received; i++) {
+            if (buffer[i] >= 0x40 && buffer[i] <= 0x7E) break;
+        }
+    } else if (buffer[i] == 'O') {
+        i++;
+    }
+
+    return i < received ? i : received - 1;
+}
+
+bool process_tty_input(Tty *tty, RingBuffer *key_events, _Atomic bool *fast_forward) {
+    uint8_t buffer[64];
+    uint64_t now = now_nanoseconds();
+    ssize_t received;
+
+    flush_key_releases(key_events);
+    while ((received = read(STDIN_FILENO, buffer, sizeof(buffer))) > 0) {
+        for (ssize_t i = 0; i < received; i++) {
+            if (buffer[i] == CTRL_C) {
+                return true;
+            }
+
+            // A lone escape is the escape key, otherwise it starts a sequence for another key
+            if (buffer[i] == ESCAPE) {
+                ssize_t end = escape_sequence_end(buffer, i, received);
+                if (end == i) {
+                    return true;
+                }
+                i = end;
+                continue;
+            }
+
+            // Same fast forward hotkey as the window
+            if (buffer[i] == '`') {
+                atomic_store(fast_forward, !atomic_load(fast_forward));
+                continue;
+            }
+
+            uint16_t mask = map_key(tolower(buffer[i]));
+            if (mask == 0) continue;
+
+            int key = __builtin_ctz(mask);
+            if (tty->held[key] == 0) {
+                queue_key(key_events, now, key, true);
+            } else {
+                tty->repeating[key] = true;
+            }
+            tty->held[key] = now;
+        }
+    }
+
+    // Auto repeat keeps a held key fresh, once it stops the key has been let go. Before the
+    // first repeat there's a longer wait, so a held key isn't let go before repeating starts
+    for (int key = 0; key < NUM_OF_KEYS; key++) {
+        uint64_t hold = tty->repeating[key] ? TTY_KEY_HOLD_NANOSECONDS : TTY_KEY_FIRST_HOLD_NANOSECONDS;
+
+        if (tty->held[key] != 0 && now - tty->held[key] > hold) {
+            queue_key(key_events, now, key, false);
+            tty->held[key] = 0;
+            tty->repeating[key] = false;
+        }
+    }
+
+    return false;
+}
+
+void cleanup_tty(Tty *tty) {
+    emit(tty, "\x1B[0m\x1B[?25h\x1B[?1049l");
+    flush_tty(tty);
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, &tty->original);
+
+    free(tty->output);
+    tty->output = NULL;
+}
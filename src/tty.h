@@ -0,0 +1,40 @@
+#ifndef TTY_H_
+#define TTY_H_
+
+#include "consts.h"
+#include "frame.h"
+#include "ring.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <termios.h>
+
+// Draws frames in the terminal with half block characters, two pixels to a cell,
+// and reads keys from stdin in raw mode
+typedef struct {
+    struct termios original;
+    // Each cell's top and bottom colour index as top | bottom << 2, TTY_UNDRAWN until drawn
+    uint8_t cells[HIRES_SCREEN_HEIGHT / 2][HIRES_SCREEN_WIDTH];
+    bool hires;
+    // Colours the terminal is currently set to, -1 if unknown
+    int foreground;
+    int background;
+    uint32_t colours[NUM_OF_COLOURS];
+    // When each key was last seen, 0 if it isn't held
+    uint64_t held[NUM_OF_KEYS];
+    // Set once a held key has auto repeated
+    bool repeating[NUM_OF_KEYS];
+    char *output;
+    size_t output_used;
+} Tty;
+
+bool init_tty(Tty *tty);
+// Only writes the cells that changed since the last frame
+void update_tty(Tty *tty, Frame const *frame);
+// Queues key presses and releases, returns true if the user wants to quit
+bool process_tty_input(Tty *tty, RingBuffer *key_events, _Atomic bool *fast_forward);
+// Puts the terminal back the way it was
+void cleanup_tty(Tty *tty);
+
+#endif
@@ -0,0 +1,209 @@
+#include "wall.h"
+#include "args.h"
+#include "chip8.h"
+#include "consts.h"
+#include "io.h"
+#include "render.h"
+#include "structs.h"
+#include "timing.h"
+#include <SDL2/SDL.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static void cleanup_wall(Wall *wall) {
+    for (int i = 0; i < wall->num_of_chips; i++) {
+        cleanup_chip8(wall->chips[i]);
+    }
+    free(wall->chips);
+    free(wall->pixels);
+
+    if (wall->atlas != NULL) SDL_DestroyTexture(wall->atlas);
+    if (wall->renderer != NULL) SDL_DestroyRenderer(wall->renderer);
+    if (wall->window != NULL) SDL_DestroyWindow(wall->window);
+    SDL_Quit();
+}
+
+static bool init_wall(Wall *wall, Args const *args) {
+    wall->num_of_chips = 0;
+    wall->focus = 0;
+    wall->cycles_per_frame = args->target_cycles / TARGET_FRAMES_PER_SECOND;
+    // Tiles are always high resolution sized, so halve the scale to keep low resolution ROMs the usual size
+    wall->scale = args->scale > 1 ? args->scale / 2 : 1;
+    wall->columns = ceil(sqrt(args->num_of_roms));
+    wall->rows = (args->num_of_roms + wall->columns - 1) / wall->columns;
+    wall->window = NULL;
+    wall->renderer = NULL;
+    wall->atlas = NULL;
+
+    int width = wall->columns * HIRES_SCREEN_WIDTH;
+    int height = wall->rows * HIRES_SCREEN_HEIGHT;
+    wall->pixels = calloc((size_t) width * height, sizeof(uint32_t));
+    wall->chips = calloc(args->num_of_roms, sizeof(Chip8 *));
+    if (wall->pixels == NULL || wall->chips == NULL) {
+        printf("Failed to allocate the wall\n");
+        cleanup_wall(wall);
+        return false;
+    }
+
+    for (int i = 0; i < args->num_of_roms; i++) {
+        Chip8 *chip = create_chip8(NULL, args->mode, args->quirks, args->foreground, args->background);
+        if (chip == NULL) {
+            cleanup_wall(wall);
+            return false;
+        }
+        wall->chips[wall->num_of_chips++] = chip;
+
+        if (load_rom(chip, args->roms[i])) {
+            cleanup_wall(wall);
+            return false;
+        }
+    }
+
+    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
+        printf("SDL could not initialize! SDL_Error: %s\n", SDL_GetError());
+        cleanup_wall(wall);
+        return false;
+    }
+
+    wall->window = SDL_CreateWindow("CHIP8", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, width * wall->scale,
+                                    height * wall->scale, SDL_WINDOW_SHOWN);
+    // No vsync, the tiles run on this thread and are paced by run_wall so a 50Hz monitor doesn't slow them down
+    if (wall->window != NULL) {
+        wall->renderer = SDL_CreateRenderer(wall->window, -1, SDL_RENDERER_ACCELERATED);
+    }
+    if (wall->renderer != NULL) {
+        wall->atlas = SDL_CreateTexture(wall->renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING,
+                                        width, height);
+    }
+
+    if (wall->atlas == NULL) {
+        printf("Window could not be created! SDL_Error: %s\n", SDL_GetError());
+        cleanup_wall(wall);
+        return false;
+    }
+
+    return true;
+}
+
+// Keys go to the focused tile, Tab or a click moves the focus. Returns true to quit
+static bool process_wall_input(Wall *wall) {
+    SDL_Event event;
+    Chip8 *chip = wall->chips[wall->focus];
+
+    while (SDL_PollEvent(&event)) {
+        if (event.type == SDL_QUIT) {
+            return true;
+        }
+
+        if (event.type == SDL_MOUSEBUTTONDOWN) {
+            int column = event.button.x / (HIRES_SCREEN_WIDTH * wall->scale);
+            int row = event.button.y / (HIRES_SCREEN_HEIGHT * wall->scale);
+            int tile = row * wall->columns + column;
+
+            if (column < wall->columns && tile < wall->num_of_chips) {
+                // Keys held on the old tile would otherwise stay down forever
+                chip->keys_pressed = 0;
+                wall->focus = tile;
+                chip = wall->chips[tile];
+            }
+        }
+
+        if (event.type == SDL_KEYDOWN || event.type == SDL_KEYUP) {
+            if (event.key.keysym.sym == SDLK_ESCAPE) {
+                return true;
+            }
+
+            if (event.key.keysym.sym == SDLK_TAB) {
+                if (event.type == SDL_KEYDOWN) {
+                    int step = (event.key.keysym.mod & KMOD_SHIFT) ? wall->num_of_chips - 1 : 1;
+                    chip->keys_pressed = 0;
+                    wall->focus = (wall->focus + step) % wall->num_of_chips;
+                    chip = wall->chips[wall->focus];
+                }
+                continue;
+            }
+
+            if (event.key.repeat) continue;
+
+            uint16_t mask = map_key(event.key.keysym.sym);
+            if (event.type == SDL_KEYDOWN) {
+                chip->keys_pressed |= mask;
+            } else {
+                chip->keys_pressed &= ~mask;
+            }
+        }
+    }
+
+    return false;
+}
+
+static void draw_tile(Wall *wall, int tile) {
+    Chip8 const *chip = wall->chips[tile];
+    int pitch = wall->columns * HIRES_SCREEN_WIDTH * sizeof(uint32_t);
+    int x = (tile % wall->columns) * HIRES_SCREEN_WIDTH;
+    int y = (tile / wall->columns) * HIRES_SCREEN_HEIGHT;
+    uint32_t colours[NUM_OF_COLOURS] = { chip->background_colour, chip->foreground_colour, DEFAULT_PLANE_2_COLOUR,
+                                         DEFAULT_OVERLAP_COLOUR };
+    uint32_t *origin = wall->pixels + (size_t) y * (pitch / sizeof(uint32_t)) + x;
+
+    // Low resolution is doubled to fill the tile
+    if (chip->hires) {
+        expand_screen(chip->screen, chip->mode >= MODE_XOCHIP ? NUM_OF_PLANES : 1, HIRES_SCREEN_WIDTH,
+                      HIRES_SCREEN_HEIGHT, colours, origin, pitch, 1);
+    } else {
+        expand_screen(chip->screen, chip->mode >= MODE_XOCHIP ? NUM_OF_PLANES : 1, SCREEN_WIDTH, SCREEN_HEIGHT,
+                      colours, origin, pitch, 2);
+    }
+}
+
+static void present_wall(Wall *wall) {
+    int pitch = wall->columns * HIRES_SCREEN_WIDTH * sizeof(uint32_t);
+    SDL_Rect focus = { (wall->focus % wall->columns) * HIRES_SCREEN_WIDTH * wall->scale,
+                       (wall->focus / wall->columns) * HIRES_SCREEN_HEIGHT * wall->scale,
+                       HIRES_SCREEN_WIDTH * wall->scale, HIRES_SCREEN_HEIGHT * wall->scale };
+
+    // One upload and one copy for every tile
+    SDL_UpdateTexture(wall->atlas, NULL, wall->pixels, pitch);
+    SDL_RenderClear(wall->renderer);
+    SDL_RenderCopy(wall->renderer, wall->atlas, NULL, NULL);
+
+    if (wall->num_of_chips > 1) {
+        SDL_SetRenderDrawColor(wall->renderer, 0xFF, 0xD1, 0x00, 0xFF);
+        SDL_RenderDrawRect(wall->renderer, &focus);
+        SDL_SetRenderDrawColor(wall->renderer, 0, 0, 0, 0xFF);
+    }
+
+    SDL_RenderPresent(wall->renderer);
+}
+
+bool run_wall(Args const *args) {
+    Wall wall;
+    uint64_t delay = NANOSECS_IN_SECOND / TARGET_FRAMES_PER_SECOND;
+    uint64_t next = now_nanoseconds();
+
+    if (!init_wall(&wall, args)) {
+        return false;
+    }
+
+    while (!process_wall_input(&wall)) {
+        for (int i = 0; i < wall.num_of_chips; i++) {
+            run_frame(wall.chips[i], wall.cycles_per_frame);
+            draw_tile(&wall, i);
+        }
+        present_wall(&wall);
+
+        // Don't try to catch up after a stall
+        next += delay;
+        uint64_t now = now_nanoseconds();
+        if (now > next + delay) {
+            next = now;
+        }
+        sleep_until_nanoseconds(next);
+    }
+
+    cleanup_wall(&wall);
+    return true;
+}
@@ -0,0 +1,32 @@
+#ifndef WALL_H_
+#define WALL_H_
+
+#include "args.h"
+#include "structs.h"
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Many ROMs tiled in one window. Every machine runs on the main thread and draws into
+// one texture atlas, so each extra instance only costs its Chip8
+typedef struct {
+    SDL_Window *window;
+    SDL_Renderer *renderer;
+    SDL_Texture *atlas;
+    // Atlas pixels, tiles are HIRES_SCREEN_WIDTH x HIRES_SCREEN_HEIGHT
+    uint32_t *pixels;
+    int columns;
+    int rows;
+    // Window pixels per tile pixel
+    int scale;
+    Chip8 **chips;
+    int num_of_chips;
+    // Tile that gets the keyboard
+    int focus;
+    uint64_t cycles_per_frame;
+} Wall;
+
+// Runs every ROM in args until the window is closed, returns false if it couldn't start
+bool run_wall(Args const *args);
+
+#endif
@@ -0,0 +1,534 @@
+#include "chip8.h"
+#include "consts.h"
+#include "counters.h"
+#include "dispatch.h"
+#include "render.h"
+#include "structs.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC
+#endif
+
+// Per handler microbenchmarks. Every benchmark calls one function in a tight loop with operands
+// drawn from a pregenerated random table, keeps the best of several runs and reports
+// nanoseconds and TSC cycles per call. Results can be written out and compared with a baseline.
+// With --rom it times whole frames of a ROM on either interpreter instead
+
+#define DEFAULT_ITERATIONS 200000
+#define DEFAULT_THRESHOLD 10.0
+#define RUNS 5
+#define NUM_OF_OPERANDS 4096
+#define MAXIMUM_RESULTS 128
+#define MAXIMUM_NAME 32
+#define DEFAULT_FRAMES 600
+#define DEFAULT_CYCLES_PER_FRAME 1000
+
+typedef struct {
+    uint8_t x;
+    uint8_t y;
+    uint8_t n;
+    uint8_t nn;
+    uint16_t nnn;
+} Operands;
+
+typedef struct {
+    char const *name;
+    void (*run)(Chip8 *chip, Operands const *operands);
+} Benchmark;
+
+typedef struct {
+    char name[MAXIMUM_NAME];
+    double nanoseconds;
+    double cycles;
+    // Hardware events per call, only filled in when counting
+    double counters[NUM_OF_COUNTERS];
+} Measurement;
+
+static Operands operands[NUM_OF_OPERANDS];
+static Quirks quirks;
+// NULL unless --counters was given and at least one counter opened
+static Counters *counters = NULL;
+static uint32_t pixels[HIRES_SCREEN_WIDTH * HIRES_SCREEN_HEIGHT * 4];
+
+// Each benchmark is a call with whatever setup keeps the handler on its normal path
+#define BENCH(name, call) \
+    static void bench_##name(Chip8 *chip, Operands const *op) { call; }
+
+BENCH(00E0, exec_00E0(chip))
+BENCH(00EE, chip->stack_pointer = 1; exec_00EE(chip))
+BENCH(00CN, exec_00CN(chip, op->n))
+BENCH(00DN, exec_00DN(chip, op->n))
+BENCH(00FB, exec_00FB(chip))
+BENCH(00FC, exec_00FC(chip))
+BENCH(00FE, exec_00FE(chip))
+BENCH(00FF, exec_00FF(chip))
+BENCH(1NNN, exec_1NNN(chip, op->nnn))
+BENCH(2NNN, chip->stack_pointer = 0; exec_2NNN(chip, op->nnn))
+BENCH(3XNN, exec_3XNN(chip, op->x, op->nn))
+BENCH(4XNN, exec_4XNN(chip, op->x, op->nn))
+BENCH(5XY0, exec_5XY0(chip, op->x, op->y))
+BENCH(5XY2, exec_5XY2(chip, op->x, op->y))
+BENCH(5XY3, exec_5XY3(chip, op->x, op->y))
+BENCH(6XNN, exec_6XNN(chip, op->x, op->nn))
+BENCH(7XNN, exec_7XNN(chip, op->x, op->nn))
+BENCH(8XY0, exec_8XY0(chip, op->x, op->y))
+BENCH(8XY1, exec_8XY1(chip, op->x, op->y, quirks))
+BENCH(8XY2, exec_8XY2(chip, op->x, op->y, quirks))
+BENCH(8XY3, exec_8XY3(chip, op->x, op->y, quirks))
+BENCH(8XY4, exec_8XY4(chip, op->x, op->y))
+BENCH(8XY5, exec_8XY5(chip, op->x, op->y))
+BENCH(8XY6, exec_8XY6(chip, op->x, op->y, quirks))
+BENCH(8XY7, exec_8XY7(chip, op->x, op->y))
+BENCH(8XYE, exec_8XYE(chip, op->x, op->y, quirks))
+BENCH(9XY0, exec_9XY0(chip, op->x, op->y))
+BENCH(ANNN, exec_ANNN(chip, op->nnn))
+BENCH(BNNN, exec_BNNN(chip, op->nnn, quirks))
+BENCH(CXNN, exec_CXNN(chip, op->x, op->nn))
+BENCH(DXYN, chip->hires = false; chip->display_interrupt_triggered = true; exec_DXYN(chip, op->x, op->y, op->n, quirks))
+BENCH(DXY0, chip->hires = true; chip->display_interrupt_triggered = true; exec_DXY0(chip, op->x, op->y, quirks))
+BENCH(EX9E, exec_EX9E(chip, op->x))
+BENCH(EXA1, exec_EXA1(chip, op->x))
+BENCH(FX07, exec_FX07(chip, op->x))
+BENCH(FX0A, chip->keys_snapshot = op->nnn; exec_FX0A(chip, op->x))
+BENCH(FX15, exec_FX15(chip, op->x))
+BENCH(FX18, exec_FX18(chip, op->x))
+BENCH(FX1E, exec_FX1E(chip, op->x))
+BENCH(FX29, exec_FX29(chip, op->x))
+BENCH(FX30, exec_FX30(chip, op->x))
+BENCH(FX33, exec_FX33(chip, op->x))
+BENCH(FX55, exec_FX55(chip, op->x, quirks))
+BENCH(FX65, exec_FX65(chip, op->x, quirks))
+BENCH(FX75, exec_FX75(chip, op->x))
+BENCH(FX85, exec_FX85(chip, op->x))
+BENCH(F000, exec_F000(chip))
+BENCH(FN01, exec_FN01(chip, op->x))
+BENCH(F002, exec_F002(chip))
+BENCH(FX3A, exec_FX3A(chip, op->x))
+
+static void bench_decode(Chip8 *chip, Operands const *op) {
+    Instruction instruction;
+    chip->pc = op->nnn;
+    decode(chip, &instruction);
+}
+
+static void bench_update_timers(Chip8 *chip, Operands const *op) {
+    chip->delay_timer = op->nn;
+    chip->sound_timer = op->n;
+    update_timers(chip);
+}
+
+static void bench_expand_lores(Chip8 *chip, Operands const *op) {
+    uint32_t colours[NUM_OF_COLOURS] = { BLACK, WHITE, ORANGE, SAGE };
+    expand_screen((uint64_t const (*)[HIRES_SCREEN_HEIGHT][SCREEN_ROW_WORDS]) chip->screen, 1, SCREEN_WIDTH,
+                  SCREEN_HEIGHT, colours, pixels, SCREEN_WIDTH * sizeof(uint32_t), 1);
+}
+
+static void bench_expand_hires(Chip8 *chip, Operands const *op) {
+    uint32_t colours[NUM_OF_COLOURS] = { BLACK, WHITE, ORANGE, SAGE };
+    expand_screen((uint64_t const (*)[HIRES_SCREEN_HEIGHT][SCREEN_ROW_WORDS]) chip->screen, 1, HIRES_SCREEN_WIDTH,
+                  HIRES_SCREEN_HEIGHT, colours, pixels, HIRES_SCREEN_WIDTH * sizeof(uint32_t), 1);
+}
+
+static void bench_expand_planes(Chip8 *chip, Operands const *op) {
+    uint32_t colours[NUM_OF_COLOURS] = { BLACK, WHITE, ORANGE, SAGE };
+    expand_screen((uint64_t const (*)[HIRES_SCREEN_HEIGHT][SCREEN_ROW_WORDS]) chip->screen, 2, HIRES_SCREEN_WIDTH,
+                  HIRES_SCREEN_HEIGHT, colours, pixels, HIRES_SCREEN_WIDTH * sizeof(uint32_t), 1);
+}
+
+static void bench_expand_scaled(Chip8 *chip, Operands const *op) {
+    uint32_t colours[NUM_OF_COLOURS] = { BLACK, WHITE, ORANGE, SAGE };
+    expand_screen((uint64_t const (*)[HIRES_SCREEN_HEIGHT][SCREEN_ROW_WORDS]) chip->screen, 1, SCREEN_WIDTH,
+                  SCREEN_HEIGHT, colours, pixels, SCREEN_WIDTH * 2 * 2 * sizeof(uint32_t), 2);
+}
+
+#define ENTRY(name) { #name, bench_##name }
+
+static Benchmark const BENCHMARKS[] = {
+    ENTRY(00E0), ENTRY(00EE), ENTRY(00CN), ENTRY(00DN), ENTRY(00FB), ENTRY(00FC), ENTRY(00FE), ENTRY(00FF),
+    ENTRY(1NNN), ENTRY(2NNN), ENTRY(3XNN), ENTRY(4XNN), ENTRY(5XY0), ENTRY(5XY2), ENTRY(5XY3), ENTRY(6XNN),
+    ENTRY(7XNN), ENTRY(8XY0), ENTRY(8XY1), ENTRY(8XY2), ENTRY(8XY3), ENTRY(8XY4), ENTRY(8XY5), ENTRY(8XY6),
+    ENTRY(8XY7), ENTRY(8XYE), ENTRY(9XY0), ENTRY(ANNN), ENTRY(BNNN), ENTRY(CXNN), ENTRY(DXYN), ENTRY(DXY0),
+    ENTRY(EX9E), ENTRY(EXA1), ENTRY(FX07), ENTRY(FX0A), ENTRY(FX15), ENTRY(FX18), ENTRY(FX1E), ENTRY(FX29),
+    ENTRY(FX30), ENTRY(FX33), ENTRY(FX55), ENTRY(FX65), ENTRY(FX75), ENTRY(FX85), ENTRY(F000), ENTRY(FN01),
+    ENTRY(F002), ENTRY(FX3A), ENTRY(decode), ENTRY(update_timers), ENTRY(expand_lores), ENTRY(expand_hires),
+    ENTRY(expand_planes), ENTRY(expand_scaled)
+};
+
+#define NUM_OF_BENCHMARKS (sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]))
+
+static uint64_t now() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t) time.tv_sec * NANOSECS_IN_SECOND + time.tv_nsec;
+}
+
+static uint64_t ticks() {
+#ifdef HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static void generate_operands(uint32_t seed) {
+    srand(seed);
+    for (int i = 0; i < NUM_OF_OPERANDS; i++) {
+        operands[i].x = rand() & 0xF;
+        operands[i].y = rand() & 0xF;
+        operands[i].n = rand() & 0xF;
+        operands[i].nn = rand() & 0xFF;
+        operands[i].nnn = rand() & 0xFFF;
+    }
+}
+
+// Random registers, memory and screen so nothing runs on all zeroes
+static void randomise(Chip8 *chip) {
+    for (int i = 0; i < NUM_OF_REGISTERS; i++) {
+        chip->registers[i] = rand();
+    }
+    for (uint32_t i = ROM_START_MEMORY_ADDR; i < chip->memory_size; i++) {
+        chip->memory[i] = rand();
+    }
+    for (int plane = 0; plane < NUM_OF_PLANES; plane++) {
+        for (int y = 0; y < HIRES_SCREEN_HEIGHT; y++) {
+            for (int w = 0; w < SCREEN_ROW_WORDS; w++) {
+                chip->screen[plane][y][w] = ((uint64_t) rand() << 32) ^ rand();
+            }
+        }
+    }
+    chip->keys_pressed = rand();
+}
+
+static void measure(Benchmark const *benchmark, Chip8 *chip, uint64_t iterations, Measurement *result) {
+    uint64_t before[NUM_OF_COUNTERS];
+    uint64_t after[NUM_OF_COUNTERS];
+    double best_nanoseconds = INFINITY;
+
+    for (int run = 0; run < RUNS; run++) {
+        randomise(chip);
+
+        if (counters != NULL) read_counters(counters, before);
+        uint64_t start = now();
+        uint64_t start_ticks = ticks();
+        for (uint64_t i = 0; i < iterations; i++) {
+            benchmark->run(chip, &operands[i % NUM_OF_OPERANDS]);
+        }
+        uint64_t end_ticks = ticks();
+        uint64_t end = now();
+        if (counters != NULL) read_counters(counters, after);
+
+        double nanoseconds = (double) (end - start) / iterations;
+        if (nanoseconds < best_nanoseconds) {
+            best_nanoseconds = nanoseconds;
+            result->cycles = (double) (end_ticks - start_ticks) / iterations;
+            for (int c = 0; counters != NULL && c < NUM_OF_COUNTERS; c++) {
+                result->counters[c] = (double) (after[c] - before[c]) / iterations;
+            }
+        }
+    }
+
+    snprintf(result->name, sizeof(result->name), "%s", benchmark->name);
+    result->nanoseconds = best_nanoseconds;
+}
+
+// Runs whole frames the way the emulator does, counting per frame and per instruction
+static bool measure_rom(char *rom, uint8_t mode, bool table, uint64_t frames, uint64_t cycles_per_frame,
+                        FILE *console, Measurement *result) {
+    uint64_t before[NUM_OF_COUNTERS];
+    uint64_t after[NUM_OF_COUNTERS];
+    uint64_t totals[NUM_OF_COUNTERS] = { 0 };
+    uint64_t elapsed = 0;
+    uint64_t elapsed_ticks = 0;
+    uint64_t slowest = 0;
+    uint8_t profile = mode == MODE_XOCHIP ? QUIRKS_XO : mode == MODE_SCHIP ? QUIRKS_SCHIP : QUIRKS_VIP;
+
+    Chip8 *chip = create_chip8(NULL, mode, profile, WHITE, BLACK);
+    if (chip == NULL) return false;
+    if (load_rom(chip, rom)) {
+        cleanup_chip8(chip);
+        return false;
+    }
+
+    for (uint64_t frame = 0; frame < frames; frame++) {
+        if (counters != NULL) read_counters(counters, before);
+        uint64_t start = now();
+        uint64_t start_ticks = ticks();
+
+        if (table) {
+            start_frame(chip);
+            for (uint64_t i = 0; i < cycles_per_frame; i++) {
+                cycle_table(chip);
+            }
+        } else {
+            run_frame(chip, cycles_per_frame);
+        }
+
+        uint64_t end_ticks = ticks();
+        uint64_t end = now();
+        if (counters != NULL) read_counters(counters, after);
+
+        elapsed += end - start;
+        elapsed_ticks += end_ticks - start_ticks;
+        if (end - start > slowest) slowest = end - start;
+        for (int c = 0; counters != NULL && c < NUM_OF_COUNTERS; c++) {
+            totals[c] += after[c] - before[c];
+        }
+    }
+
+    cleanup_chip8(chip);
+
+    uint64_t instructions = frames * cycles_per_frame;
+    snprintf(result->name, sizeof(result->name), "rom-%s", table ? "table" : "switch");
+    result->nanoseconds = (double) elapsed / instructions;
+    result->cycles = (double) elapsed_ticks / instructions;
+
+    fprintf(console, "%s on the %s interpreter, %llu frames of %llu instructions\n", rom, table ? "table" : "switch",
+            (unsigned long long) frames, (unsigned long long) cycles_per_frame);
+    fprintf(console, "  %-16s %14s %14s\n", "", "per frame", "per instruction");
+    fprintf(console, "  %-16s %14.0f %14.2f\n", "ns", (double) elapsed / frames, result->nanoseconds);
+    fprintf(console, "  %-16s %14.0f %14.2f\n", "slowest frame ns", (double) slowest, (double) slowest / cycles_per_frame);
+
+    for (int c = 0; counters != NULL && c < NUM_OF_COUNTERS; c++) {
+        result->counters[c] = (double) totals[c] / instructions;
+        if (counter_available(counters, c)) {
+            fprintf(console, "  %-16s %14.0f %14.2f\n", counter_name(c), (double) totals[c] / frames, result->counters[c]);
+        }
+    }
+    fprintf(console, "\n");
+
+    return true;
+}
+
+static int read_results(char const *path, Measurement *results) {
+    int count = 0;
+
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        printf("Failed to open baseline %s\n", path);
+        return -1;
+    }
+
+    char line[256];
+    while (count < MAXIMUM_RESULTS && fgets(line, sizeof(line), fp) != NULL) {
+        Measurement *result = &results[count];
+        if (line[0] == '#') continue;
+        if (sscanf(line, "%31s %lf %lf", result->name, &result->nanoseconds, &result->cycles) == 3) {
+            count++;
+        }
+    }
+
+    fclose(fp);
+    return count;
+}
+
+static bool write_results(char const *path, Measurement const *results, int count) {
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) {
+        printf("Failed to open %s for writing\n", path);
+        return false;
+    }
+
+    fprintf(fp, "# name\tns_per_op\tcycles_per_op");
+    for (int c = 0; counters != NULL && c < NUM_OF_COUNTERS; c++) {
+        if (counter_available(counters, c)) fprintf(fp, "\t%s", counter_name(c));
+    }
+    fprintf(fp, "\n");
+
+    for (int i = 0; i < count; i++) {
+        fprintf(fp, "%s\t%.3f\t%.1f", results[i].name, results[i].nanoseconds, results[i].cycles);
+        for (int c = 0; counters != NULL && c < NUM_OF_COUNTERS; c++) {
+            if (counter_available(counters, c)) fprintf(fp, "\t%.2f", results[i].counters[c]);
+        }
+        fprintf(fp, "\n");
+    }
+
+    return fclose(fp) == 0;
+}
+
+static void print_header(FILE *console, bool comparing) {
+    fprintf(console, "%-16s %10s %10s", "benchmark", "ns/op", "cycles/op");
+    for (int c = 0; counters != NULL && c < NUM_OF_COUNTERS; c++) {
+        if (counter_available(counters, c)) fprintf(console, " %14s", counter_name(c));
+    }
+    fprintf(console, comparing ? " %10s\n" : "\n", "change");
+}
+
+// Prints a result row, returns true if it's slower than the baseline by more than threshold
+static bool report(FILE *console, Measurement const *result, Measurement const *baseline, int baseline_count,
+                   double threshold) {
+    Measurement const *previous = NULL;
+    bool regressed = false;
+
+    fprintf(console, "%-16s %10.2f %10.1f", result->name, result->nanoseconds, result->cycles);
+    for (int c = 0; counters != NULL && c < NUM_OF_COUNTERS; c++) {
+        if (counter_available(counters, c)) fprintf(console, " %14.2f", result->counters[c]);
+    }
+
+    for (int j = 0; j < baseline_count; j++) {
+        if (strcmp(baseline[j].name, result->name) == 0) previous = &baseline[j];
+    }
+
+    if (previous != NULL && previous->nanoseconds > 0) {
+        double change = (result->nanoseconds - previous->nanoseconds) / previous->nanoseconds * 100.0;
+        regressed = change > threshold;
+        fprintf(console, " %+9.1f%%%s", change, regressed ? "  REGRESSION" : "");
+    }
+    fprintf(console, "\n");
+
+    return regressed;
+}
+
+static void usage() {
+    printf("Usage: ./bench [OPTIONS]\n");
+    printf("\nOptions:\n");
+    printf("    -i, --iterations [N]   Calls per run (Default %d)\n", DEFAULT_ITERATIONS);
+    printf("    -f, --filter [TEXT]    Only run benchmarks whose name contains TEXT\n");
+    printf("    -o, --output [FILE]    Write the results as tab separated values\n");
+    printf("    -b, --baseline [FILE]  Compare against earlier results\n");
+    printf("    -t, --threshold [PCT]  Slowdown that counts as a regression (Default %.0f%%)\n", DEFAULT_THRESHOLD);
+    printf("    --counters             Count cycles, instructions, branch and L1d misses (Linux perf events)\n");
+    printf("    --rom [FILE]           Time whole frames of a ROM on both interpreters instead\n");
+    printf("    -m, --mode [MODE]      Instruction set for --rom, chip8, schip or xochip (Default chip8)\n");
+    printf("    --frames [N]           Frames to run with --rom (Default %d)\n", DEFAULT_FRAMES);
+    printf("    -c, --cycles [N]       Instructions per frame with --rom (Default %d)\n", DEFAULT_CYCLES_PER_FRAME);
+}
+
+int main(int argc, char *argv[]) {
+    static Measurement results[MAXIMUM_RESULTS];
+    static Measurement baseline[MAXIMUM_RESULTS];
+    Counters hardware;
+    uint64_t iterations = DEFAULT_ITERATIONS;
+    uint64_t frames = DEFAULT_FRAMES;
+    uint64_t cycles_per_frame = DEFAULT_CYCLES_PER_FRAME;
+    uint8_t mode = MODE_CHIP8;
+    double threshold = DEFAULT_THRESHOLD;
+    bool count_events = false;
+    char *filter = NULL;
+    char *output = NULL;
+    char *baseline_path = NULL;
+    char *rom = NULL;
+    int baseline_count = 0;
+    int count = 0;
+    int regressions = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--counters") == 0) {
+            count_events = true;
+            continue;
+        }
+
+        if (i + 1 == argc) {
+            usage();
+            return 1;
+        }
+
+        if (strcmp(argv[i], "--iterations") == 0 || strcmp(argv[i], "-i") == 0) {
+            iterations = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--filter") == 0 || strcmp(argv[i], "-f") == 0) {
+            filter = argv[++i];
+        } else if (strcmp(argv[i], "--output") == 0 || strcmp(argv[i], "-o") == 0) {
+            output = argv[++i];
+        } else if (strcmp(argv[i], "--baseline") == 0 || strcmp(argv[i], "-b") == 0) {
+            baseline_path = argv[++i];
+        } else if (strcmp(argv[i], "--threshold") == 0 || strcmp(argv[i], "-t") == 0) {
+            threshold = strtod(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--rom") == 0) {
+            rom = argv[++i];
+        } else if (strcmp(argv[i], "--frames") == 0) {
+            frames = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--cycles") == 0 || strcmp(argv[i], "-c") == 0) {
+            cycles_per_frame = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--mode") == 0 || strcmp(argv[i], "-m") == 0) {
+            i++;
+            if (strcmp(argv[i], "chip8") == 0) {
+                mode = MODE_CHIP8;
+            } else if (strcmp(argv[i], "schip") == 0) {
+                mode = MODE_SCHIP;
+            } else if (strcmp(argv[i], "xochip") == 0) {
+                mode = MODE_XOCHIP;
+            } else {
+                printf("ERROR: Invalid mode %s\n", argv[i]);
+                return 1;
+            }
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    if (iterations == 0 || frames == 0 || cycles_per_frame == 0) {
+        printf("ERROR: Iterations, frames and cycles must be non zero positive numbers\n");
+        return 1;
+    }
+
+    if (baseline_path != NULL) {
+        baseline_count = read_results(baseline_path, baseline);
+        if (baseline_count < 0) return 1;
+    }
+
+    if (count_events) {
+        if (open_counters(&hardware)) {
+            counters = &hardware;
+        } else {
+            printf("Hardware counters are unavailable (check perf_event_paranoid), timing only\n");
+        }
+    }
+
+    // Handlers with nothing to do print, keep that out of the way
+    FILE *console = fdopen(dup(fileno(stdout)), "w");
+    if (console == NULL || freopen("/dev/null", "w", stdout) == NULL) {
+        return 1;
+    }
+
+    if (rom != NULL) {
+        for (int table = 0; table <= 1; table++) {
+            if (!measure_rom(rom, mode, table, frames, cycles_per_frame, console, &results[count++])) {
+                fprintf(console, "Failed to load %s\n", rom);
+                return 1;
+            }
+        }
+    } else {
+        // XO-CHIP has the most memory and every instruction, so every handler can run
+        Chip8 *chip = create_chip8(NULL, MODE_XOCHIP, QUIRKS_VIP, WHITE, BLACK);
+        if (chip == NULL) return 1;
+        quirks = quirk_profile(QUIRKS_VIP);
+        generate_operands(1);
+
+        for (size_t i = 0; i < NUM_OF_BENCHMARKS && count < MAXIMUM_RESULTS; i++) {
+            if (filter != NULL && strstr(BENCHMARKS[i].name, filter) == NULL) continue;
+            measure(&BENCHMARKS[i], chip, iterations, &results[count++]);
+        }
+
+        cleanup_chip8(chip);
+    }
+
+    print_header(console, baseline_count > 0);
+    for (int i = 0; i < count; i++) {
+        regressions += report(console, &results[i], baseline, baseline_count, threshold);
+    }
+
+    if (baseline_count > 0) {
+        fprintf(console, "\n%d regressions over %.0f%%\n", regressions, threshold);
+    }
+
+    fclose(console);
+
+    if (output != NULL && !write_results(output, results, count)) {
+        return 1;
+    }
+
+    if (counters != NULL) {
+        close_counters(counters);
+    }
+
+    return regressions > 0;
+}
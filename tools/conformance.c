@@ -0,0 +1,363 @@
+#include "chip8.h"
+#include "consts.h"
+#include "hash.h"
+#include "structs.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Headless conformance runner. Each manifest line names a ROM, how to run it and the hash of
+// the screen it should finish on:
+//   <rom> <mode> <quirks> <frames> <cycles per frame> <golden hash> [address=value ...]
+// ROM paths are relative to the manifest. The optional pokes are written to memory before the
+// first frame, e.g. 0x1FF=1 skips the menu in Timendus' test ROMs.
+// A golden hash of - means it hasn't been recorded yet, run with --update to fill them in.
+// Unrecorded hashes fail without --update, and so do missing ROMs with --require-all
+
+#define MAXIMUM_LINE 1024
+#define MAXIMUM_PATH 1024
+#define MAXIMUM_POKES 8
+
+typedef enum {
+    RESULT_PASS,
+    RESULT_FAIL,
+    RESULT_NEW,
+    RESULT_SKIP,
+    RESULT_ERROR
+} Result;
+
+typedef struct {
+    char rom[MAXIMUM_PATH];
+    uint8_t mode;
+    uint8_t quirks;
+    uint64_t frames;
+    uint64_t cycles_per_frame;
+    bool has_golden;
+    uint64_t golden;
+    int pokes;
+    uint16_t poke_address[MAXIMUM_POKES];
+    uint8_t poke_value[MAXIMUM_POKES];
+
+    // Where the golden hash sits in the manifest, for --update
+    int line;
+    int golden_start;
+    int golden_end;
+
+    Result result;
+    uint64_t hash;
+} Test;
+
+typedef struct {
+    Test *tests;
+    int count;
+    _Atomic int next;
+} Queue;
+
+static char const *RESULT_NAMES[] = { "PASS", "FAIL", "NEW", "SKIP", "ERROR" };
+
+static bool parse_mode(char const *text, uint8_t *mode) {
+    if (strcmp(text, "chip8") == 0) {
+        *mode = MODE_CHIP8;
+    } else if (strcmp(text, "schip") == 0) {
+        *mode = MODE_SCHIP;
+    } else if (strcmp(text, "xochip") == 0) {
+        *mode = MODE_XOCHIP;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool parse_quirks(char const *text, uint8_t *quirks) {
+    if (strcmp(text, "vip") == 0) {
+        *quirks = QUIRKS_VIP;
+    } else if (strcmp(text, "schip") == 0) {
+        *quirks = QUIRKS_SCHIP;
+    } else if (strcmp(text, "xo") == 0) {
+        *quirks = QUIRKS_XO;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Splits off the next whitespace separated token, recording where it started and ended
+static char *next_token(char *line, int *position, int *start, int *end) {
+    int i = *position;
+    while (line[i] == ' ' || line[i] == '\t') i++;
+    if (line[i] == '\0' || line[i] == '\n' || line[i] == '#') return NULL;
+
+    *start = i;
+    while (line[i] != '\0' && line[i] != ' ' && line[i] != '\t' && line[i] != '\n') i++;
+    *end = i;
+    *position = i;
+
+    return line + *start;
+}
+
+static bool parse_test(char *line, char const *directory, Test *test) {
+    char copy[MAXIMUM_LINE];
+    char *fields[6];
+    int starts[6];
+    int ends[6];
+    int position = 0;
+    int start, end;
+
+    strcpy(copy, line);
+    for (int i = 0; i < 6; i++) {
+        fields[i] = next_token(copy, &position, &starts[i], &ends[i]);
+        if (fields[i] == NULL) return false;
+    }
+
+    // Terminate the fields once they've all been found
+    for (int i = 0; i < 6; i++) {
+        copy[ends[i]] = '\0';
+    }
+
+    memset(test, 0, sizeof(Test));
+    snprintf(test->rom, sizeof(test->rom), "%s/%s", directory, fields[0]);
+    test->frames = strtoull(fields[3], NULL, 10);
+    test->cycles_per_frame = strtoull(fields[4], NULL, 10);
+    test->golden_start = starts[5];
+    test->golden_end = ends[5];
+
+    if (!parse_mode(fields[1], &test->mode) || !parse_quirks(fields[2], &test->quirks) || test->cycles_per_frame == 0) {
+        return false;
+    }
+
+    if (strcmp(fields[5], "-") != 0) {
+        char *rest;
+        test->golden = strtoull(fields[5], &rest, 16);
+        if (*rest != '\0') return false;
+        test->has_golden = true;
+    }
+
+    // Pokes are read from the original line since the copy has been cut up
+    char *poke;
+    while ((poke = next_token(line, &position, &start, &end)) != NULL) {
+        char *value;
+        if (test->pokes == MAXIMUM_POKES) return false;
+
+        test->poke_address[test->pokes] = (uint16_t) strtoul(poke, &value, 0);
+        if (*value != '=') return false;
+        test->poke_value[test->pokes] = (uint8_t) strtoul(value + 1, NULL, 0);
+        test->pokes++;
+    }
+
+    return true;
+}
+
+// The screen and resolution are all that's hashed, so timing changes that don't affect the picture still pass
+static uint64_t hash_screen(Chip8 const *chip) {
+    return xxh64(chip->screen, sizeof(chip->screen), chip->hires);
+}
+
+static void run_test(Test *test) {
+    if (access(test->rom, R_OK) != 0) {
+        test->result = RESULT_SKIP;
+        return;
+    }
+
+    Chip8 *chip = create_chip8(NULL, test->mode, test->quirks, WHITE, BLACK);
+    if (chip == NULL || load_rom(chip, test->rom)) {
+        test->result = RESULT_ERROR;
+        if (chip != NULL) cleanup_chip8(chip);
+        return;
+    }
+
+    for (int i = 0; i < test->pokes; i++) {
+        chip->memory[test->poke_address[i] & (chip->memory_size - 1)] = test->poke_value[i];
+    }
+
+    for (uint64_t frame = 0; frame < test->frames; frame++) {
+        run_frame(chip, test->cycles_per_frame);
+    }
+
+    test->hash = hash_screen(chip);
+    if (!test->has_golden) {
+        test->result = RESULT_NEW;
+    } else {
+        test->result = test->hash == test->golden ? RESULT_PASS : RESULT_FAIL;
+    }
+
+    cleanup_chip8(chip);
+}
+
+static void *worker(void *arg) {
+    Queue *queue = arg;
+    int index;
+
+    while ((index = atomic_fetch_add(&queue->next, 1)) < queue->count) {
+        run_test(&queue->tests[index]);
+    }
+
+    return NULL;
+}
+
+static void run_all(Test *tests, int count) {
+    Queue queue = { tests, count };
+    atomic_init(&queue.next, 0);
+
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = cores < 1 ? 1 : cores > count ? count : (int) cores;
+    pthread_t *workers = malloc(threads * sizeof(pthread_t));
+    int started = 0;
+
+    if (workers != NULL) {
+        for (; started < threads; started++) {
+            if (pthread_create(&workers[started], NULL, worker, &queue) != 0) break;
+        }
+    }
+
+    // If no threads could be started just do it all here
+    if (started == 0) {
+        worker(&queue);
+    }
+
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    free(workers);
+}
+
+// Rewrite the manifest with the hashes from this run
+static bool update_manifest(char const *path, char **lines, int line_count, Test const *tests, int count) {
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) {
+        printf("Failed to open %s for writing\n", path);
+        return false;
+    }
+
+    int next = 0;
+    for (int i = 0; i < line_count; i++) {
+        Test const *test = next < count && tests[next].line == i ? &tests[next++] : NULL;
+
+        if (test != NULL && (test->result == RESULT_NEW || test->result == RESULT_FAIL)) {
+            fprintf(fp, "%.*s%016llx%s", test->golden_start, lines[i], (unsigned long long) test->hash,
+                    lines[i] + test->golden_end);
+        } else {
+            fputs(lines[i], fp);
+        }
+    }
+
+    return fclose(fp) == 0;
+}
+
+int main(int argc, char *argv[]) {
+    char line[MAXIMUM_LINE];
+    char directory[MAXIMUM_PATH];
+    char *manifest = NULL;
+    bool update = false;
+    bool require_all = false;
+    char **lines = NULL;
+    int line_count = 0;
+    Test *tests = NULL;
+    int count = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--update") == 0) {
+            update = true;
+        } else if (strcmp(argv[i], "--require-all") == 0) {
+            require_all = true;
+        } else {
+            manifest = argv[i];
+        }
+    }
+
+    if (manifest == NULL) {
+        printf("Usage: ./conformance [--update] [--require-all] <manifest>\n");
+        return 1;
+    }
+
+    FILE *fp = fopen(manifest, "r");
+    if (fp == NULL) {
+        printf("Failed to open manifest %s\n", manifest);
+        return 1;
+    }
+
+    // ROMs are found relative to the manifest
+    strncpy(directory, manifest, sizeof(directory) - 1);
+    directory[sizeof(directory) - 1] = '\0';
+    char *slash = strrchr(directory, '/');
+    if (slash != NULL) {
+        *slash = '\0';
+    } else {
+        strcpy(directory, ".");
+    }
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        char **grown_lines = realloc(lines, (line_count + 1) * sizeof(char *));
+        Test *grown_tests = realloc(tests, (count + 1) * sizeof(Test));
+        if (grown_lines == NULL || grown_tests == NULL) {
+            printf("ERROR: Failed to assign memory for the manifest\n");
+            return 1;
+        }
+        lines = grown_lines;
+        tests = grown_tests;
+        lines[line_count] = strdup(line);
+
+        char *start = line + strspn(line, " \t");
+        if (*start != '#' && *start != '\n' && *start != '\0') {
+            if (!parse_test(line, directory, &tests[count])) {
+                printf("Invalid test on line %d of %s\n", line_count + 1, manifest);
+                return 1;
+            }
+            tests[count].line = line_count;
+            count++;
+        }
+        line_count++;
+    }
+    fclose(fp);
+
+    run_all(tests, count);
+
+    int totals[RESULT_ERROR + 1] = { 0 };
+    for (int i = 0; i < count; i++) {
+        Test const *test = &tests[i];
+        totals[test->result]++;
+
+        if (test->result == RESULT_SKIP) {
+            printf("%-5s %s (not found)\n", RESULT_NAMES[test->result], test->rom);
+        } else {
+            printf("%-5s %s %016llx\n", RESULT_NAMES[test->result], test->rom, (unsigned long long) test->hash);
+        }
+    }
+
+    printf("\n%d passed, %d failed, %d new, %d skipped, %d errors\n", totals[RESULT_PASS], totals[RESULT_FAIL],
+           totals[RESULT_NEW], totals[RESULT_SKIP], totals[RESULT_ERROR]);
+
+    // A run that skipped tests only vouches for the ones it ran
+    if (totals[RESULT_SKIP] > 0) {
+        printf("WARNING: %d of %d tests were skipped because their ROMs are missing%s\n", totals[RESULT_SKIP], count,
+               require_all ? "" : ", use --require-all to fail on them");
+    }
+
+    if (totals[RESULT_NEW] > 0 && !update) {
+        printf("%d tests have no recorded hash, record them with --update\n", totals[RESULT_NEW]);
+    }
+
+    int result = totals[RESULT_FAIL] > 0 || totals[RESULT_ERROR] > 0 || totals[RESULT_NEW] > 0 ||
+                 (require_all && totals[RESULT_SKIP] > 0);
+    if (update) {
+        if (!update_manifest(manifest, lines, line_count, tests, count)) {
+            result = 1;
+        } else {
+            printf("Updated %s\n", manifest);
+            result = totals[RESULT_ERROR] > 0 || (require_all && totals[RESULT_SKIP] > 0);
+        }
+    }
+
+    for (int i = 0; i < line_count; i++) {
+        free(lines[i]);
+    }
+    free(lines);
+    free(tests);
+
+    return result;
+}
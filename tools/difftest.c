@@ -0,0 +1,274 @@
+#include "chip8.h"
+#include "consts.h"
+#include "dispatch.h"
+#include "hash.h"
+#include "structs.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Runs a ROM on the switch interpreter and the table interpreter in lockstep with the same key
+// input, comparing the machines after every block of cycles. Stops at the first divergence and
+// shows the instructions leading up to it
+
+#define DEFAULT_FRAMES 600
+#define DEFAULT_BLOCK 1
+#define DEFAULT_WINDOW 16
+#define MAXIMUM_WINDOW 256
+
+typedef struct {
+    uint64_t frame;
+    uint64_t cycle;
+    uint16_t pc;
+    uint16_t opcode;
+} TraceEntry;
+
+typedef struct {
+    char *rom;
+    uint8_t mode;
+    uint8_t quirks;
+    bool custom_quirks;
+    uint64_t frames;
+    uint64_t cycles_per_frame;
+    uint64_t block;
+    uint32_t seed;
+    int window;
+} Options;
+
+static void usage() {
+    printf("Usage: ./difftest [OPTIONS] <rom file>\n");
+    printf("\nOptions:\n");
+    printf("    -m, --mode [MODE]      chip8, schip or xochip (Default chip8)\n");
+    printf("    -q, --quirks [QUIRKS]  vip, schip or xo (Default matches the mode)\n");
+    printf("    -f, --frames [N]       Frames to run (Default %d)\n", DEFAULT_FRAMES);
+    printf("    -c, --cycles [CYCLES]  Target CPU cycles per second (Default %d)\n", DEFAULT_TARGET_CYCLES_PER_SECOND);
+    printf("    -b, --block [N]        Compare every N cycles (Default %d)\n", DEFAULT_BLOCK);
+    printf("    -s, --seed [SEED]      Seed for the random key presses, 0 for none (Default 1)\n");
+    printf("    -w, --window [N]       Instructions to show before a divergence (Default %d)\n", DEFAULT_WINDOW);
+}
+
+static bool parse_number(char const *text, uint64_t *value) {
+    char *end;
+    unsigned long long parsed = strtoull(text, &end, 10);
+    if (*text == '\0' || *end != '\0') return false;
+
+    *value = parsed;
+    return true;
+}
+
+static int read_options(Options *options, int argc, char *argv[]) {
+    uint64_t value;
+
+    options->rom = NULL;
+    options->mode = MODE_CHIP8;
+    options->quirks = QUIRKS_VIP;
+    options->custom_quirks = false;
+    options->frames = DEFAULT_FRAMES;
+    options->cycles_per_frame = DEFAULT_TARGET_CYCLES_PER_SECOND / TARGET_FRAMES_PER_SECOND;
+    options->block = DEFAULT_BLOCK;
+    options->seed = 1;
+    options->window = DEFAULT_WINDOW;
+
+    for (int i = 1; i < argc; i++) {
+        char *option = argv[i];
+        if (option[0] != '-') {
+            options->rom = option;
+            break;
+        }
+
+        if (i + 1 == argc) {
+            printf("ERROR: %s needs a value\n", option);
+            return 1;
+        }
+        char *argument = argv[++i];
+
+        if (strcmp(option, "--mode") == 0 || strcmp(option, "-m") == 0) {
+            if (strcmp(argument, "chip8") == 0) {
+                options->mode = MODE_CHIP8;
+            } else if (strcmp(argument, "schip") == 0) {
+                options->mode = MODE_SCHIP;
+            } else if (strcmp(argument, "xochip") == 0) {
+                options->mode = MODE_XOCHIP;
+            } else {
+                printf("ERROR: Invalid mode %s\n", argument);
+                return 1;
+            }
+        } else if (strcmp(option, "--quirks") == 0 || strcmp(option, "-q") == 0) {
+            if (strcmp(argument, "vip") == 0) {
+                options->quirks = QUIRKS_VIP;
+            } else if (strcmp(argument, "schip") == 0) {
+                options->quirks = QUIRKS_SCHIP;
+            } else if (strcmp(argument, "xo") == 0) {
+                options->quirks = QUIRKS_XO;
+            } else {
+                printf("ERROR: Invalid quirk profile %s\n", argument);
+                return 1;
+            }
+            options->custom_quirks = true;
+        } else if ((strcmp(option, "--frames") == 0 || strcmp(option, "-f") == 0) && parse_number(argument, &value)) {
+            options->frames = value;
+        } else if ((strcmp(option, "--cycles") == 0 || strcmp(option, "-c") == 0) && parse_number(argument, &value) &&
+                   value >= TARGET_FRAMES_PER_SECOND) {
+            options->cycles_per_frame = value / TARGET_FRAMES_PER_SECOND;
+        } else if ((strcmp(option, "--block") == 0 || strcmp(option, "-b") == 0) && parse_number(argument, &value) && value > 0) {
+            options->block = value;
+        } else if ((strcmp(option, "--seed") == 0 || strcmp(option, "-s") == 0) && parse_number(argument, &value)) {
+            options->seed = (uint32_t) value;
+        } else if ((strcmp(option, "--window") == 0 || strcmp(option, "-w") == 0) && parse_number(argument, &value) &&
+                   value <= MAXIMUM_WINDOW) {
+            options->window = (int) value;
+        } else {
+            printf("ERROR: Invalid option %s %s\n", option, argument);
+            return 1;
+        }
+    }
+
+    if (!options->custom_quirks) {
+        options->quirks = options->mode == MODE_XOCHIP ? QUIRKS_XO : options->mode == MODE_SCHIP ? QUIRKS_SCHIP : QUIRKS_VIP;
+    }
+
+    return 0;
+}
+
+// Returns the name of the first thing that differs, or NULL if the machines match
+static char const *compare(Chip8 const *a, Chip8 const *b) {
+    if (a->pc != b->pc) return "pc";
+    if (a->iregister != b->iregister) return "I";
+    if (memcmp(a->registers, b->registers, sizeof(a->registers)) != 0) return "registers";
+    if (a->stack_pointer != b->stack_pointer) return "stack pointer";
+    if (memcmp(a->stack, b->stack, sizeof(a->stack)) != 0) return "stack";
+    if (a->delay_timer != b->delay_timer) return "delay timer";
+    if (a->sound_timer != b->sound_timer) return "sound timer";
+    if (a->keys_snapshot != b->keys_snapshot) return "key snapshot";
+    if (a->waiting_to_draw != b->waiting_to_draw || a->display_interrupt_triggered != b->display_interrupt_triggered) {
+        return "display interrupt";
+    }
+    if (a->random_state != b->random_state) return "random state";
+    if (a->hires != b->hires || a->planes != b->planes) return "display mode";
+    if (memcmp(a->screen, b->screen, sizeof(a->screen)) != 0) return "screen";
+    if (memcmp(a->rpl_flags, b->rpl_flags, sizeof(a->rpl_flags)) != 0) return "RPL flags";
+    if (a->pitch != b->pitch || memcmp(a->audio_pattern, b->audio_pattern, sizeof(a->audio_pattern)) != 0) return "audio";
+    if (xxh64(a->memory, a->memory_size, 0) != xxh64(b->memory, b->memory_size, 0)) return "memory";
+
+    return NULL;
+}
+
+static void print_machine(char const *name, Chip8 const *chip) {
+    printf("%-7s pc=%03X I=%03X sp=%d dt=%d st=%d memory=%016llx V:", name, chip->pc, chip->iregister,
+           chip->stack_pointer, chip->delay_timer, chip->sound_timer,
+           (unsigned long long) xxh64(chip->memory, chip->memory_size, 0));
+    for (int i = 0; i < NUM_OF_REGISTERS; i++) {
+        printf(" %02X", chip->registers[i]);
+    }
+    printf("\n");
+}
+
+static void report(char const *what, Chip8 const *reference, Chip8 const *candidate, TraceEntry const *trace,
+                   uint64_t executed, int window) {
+    printf("\nDIVERGENCE in %s\n", what);
+
+    if (strcmp(what, "memory") == 0) {
+        for (uint32_t i = 0; i < reference->memory_size; i++) {
+            if (reference->memory[i] != candidate->memory[i]) {
+                printf("First differing address %04X: switch %02X, table %02X\n", i, reference->memory[i], candidate->memory[i]);
+                break;
+            }
+        }
+    }
+
+    print_machine("switch", reference);
+    print_machine("table", candidate);
+
+    // The last entry is the instruction that diverged
+    uint64_t shown = executed < (uint64_t) window ? executed : (uint64_t) window;
+    printf("\nLast %llu instructions:\n", (unsigned long long) shown);
+    for (uint64_t i = executed - shown; i < executed; i++) {
+        TraceEntry const *entry = &trace[i % MAXIMUM_WINDOW];
+        printf("  frame %6llu cycle %10llu  %03X: %04X\n", (unsigned long long) entry->frame,
+               (unsigned long long) entry->cycle, entry->pc, entry->opcode);
+    }
+}
+
+// Randomly press and release keys every few frames, the same for both machines
+static uint16_t next_keys(uint32_t *state, uint16_t keys) {
+    if (*state == 0) return 0;
+
+    uint32_t random = *state;
+    random ^= random << 13;
+    random ^= random >> 17;
+    random ^= random << 5;
+    *state = random;
+
+    if ((random & 3) == 0) {
+        keys ^= 1 << ((random >> 8) & 0xF);
+    }
+
+    return keys;
+}
+
+int main(int argc, char *argv[]) {
+    static TraceEntry trace[MAXIMUM_WINDOW];
+    Options options;
+    uint64_t executed = 0;
+    uint16_t keys = 0;
+    int result = 0;
+
+    if (read_options(&options, argc, argv)) {
+        usage();
+        return 1;
+    }
+
+    if (options.rom == NULL) {
+        usage();
+        return 1;
+    }
+
+    Chip8 *reference = create_chip8(NULL, options.mode, options.quirks, WHITE, BLACK);
+    Chip8 *candidate = create_chip8(NULL, options.mode, options.quirks, WHITE, BLACK);
+    if (reference == NULL || candidate == NULL || load_rom(reference, options.rom) || load_rom(candidate, options.rom)) {
+        return 1;
+    }
+
+    uint32_t random = options.seed;
+    for (uint64_t frame = 0; frame < options.frames && result == 0; frame++) {
+        keys = next_keys(&random, keys);
+        reference->keys_pressed = keys;
+        candidate->keys_pressed = keys;
+
+        start_frame(reference);
+        start_frame(candidate);
+
+        for (uint64_t i = 0; i < options.cycles_per_frame; i++) {
+            TraceEntry *entry = &trace[executed % MAXIMUM_WINDOW];
+            entry->frame = frame;
+            entry->cycle = executed;
+            entry->pc = reference->pc;
+            entry->opcode = (reference->memory[reference->pc & (reference->memory_size - 1)] << 8) |
+                            reference->memory[(reference->pc + 1) & (reference->memory_size - 1)];
+
+            cycle(reference);
+            cycle_table(candidate);
+            executed++;
+
+            bool end_of_block = executed % options.block == 0 || i + 1 == options.cycles_per_frame;
+            char const *difference = end_of_block ? compare(reference, candidate) : NULL;
+            if (difference != NULL) {
+                report(difference, reference, candidate, trace, executed, options.window);
+                result = 1;
+                break;
+            }
+        }
+    }
+
+    if (result == 0) {
+        printf("No divergence in %llu frames (%llu instructions)\n", (unsigned long long) options.frames,
+               (unsigned long long) executed);
+    }
+
+    cleanup_chip8(reference);
+    cleanup_chip8(candidate);
+
+    return result;
+}
@@ -0,0 +1,119 @@
+#include "chip8.h"
+#include "consts.h"
+#include "structs.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Fuzzing harness for the interpreter core, built by make fuzz.
+// With clang's -fsanitize=fuzzer it's a libFuzzer target, otherwise main reads inputs
+// from files or stdin, which works with AFL (using its persistent mode when built with afl-clang-fast).
+//
+// Input layout:
+//   byte 0            low two bits pick the mode, the next two the quirk profile
+//   byte 1            number of frames of key input that follow, K
+//   K * 2 bytes       keys held on each frame, big endian masks
+//   the rest          the ROM
+
+#define FUZZ_MAXIMUM_FRAMES 64
+#define FUZZ_CYCLES_PER_FRAME 64
+#define FUZZ_MINIMUM_FRAMES 4
+#define FUZZ_HEADER_SIZE 2
+#define NUM_OF_MODES 3
+#define MAXIMUM_INPUT (FUZZ_HEADER_SIZE + FUZZ_MAXIMUM_FRAMES * 2 + XOCHIP_MEMORY_SIZE)
+
+// One machine per mode, each reset from an image taken straight after init
+static Chip8 *machines[NUM_OF_MODES];
+static Chip8 *pristine[NUM_OF_MODES];
+
+static bool init_machines() {
+    // The core reports unknown instructions on stdout, which would swamp the fuzzer
+    if (freopen("/dev/null", "w", stdout) == NULL) return false;
+
+    for (int mode = 0; mode < NUM_OF_MODES; mode++) {
+        machines[mode] = create_chip8(NULL, mode, QUIRKS_VIP, WHITE, BLACK);
+        if (machines[mode] == NULL) return false;
+
+        pristine[mode] = create_pristine_image(machines[mode]);
+        if (pristine[mode] == NULL) return false;
+    }
+
+    return true;
+}
+
+int LLVMFuzzerTestOneInput(uint8_t const *data, size_t size) {
+    if (machines[0] == NULL && !init_machines()) {
+        abort();
+    }
+
+    if (size < FUZZ_HEADER_SIZE) return 0;
+
+    uint8_t mode = (data[0] & 3) % NUM_OF_MODES;
+    uint8_t quirks = ((data[0] >> 2) & 3) % NUM_OF_MODES;
+    size_t frames = data[1] % (FUZZ_MAXIMUM_FRAMES + 1);
+    data += FUZZ_HEADER_SIZE;
+    size -= FUZZ_HEADER_SIZE;
+
+    if (size < frames * 2) return 0;
+    uint8_t const *keys = data;
+    data += frames * 2;
+    size -= frames * 2;
+
+    Chip8 *chip = machines[mode];
+    reset_chip8(chip, pristine[mode]);
+    set_quirks(chip, quirks);
+
+    // Oversized ROMs are rejected like they would be from disk
+    if (load_rom_from_buffer(chip, data, size)) return 0;
+
+    // Keep running a little after the input runs out so timers and FX0A get exercised
+    size_t total = frames < FUZZ_MINIMUM_FRAMES ? FUZZ_MINIMUM_FRAMES : frames;
+    for (size_t frame = 0; frame < total; frame++) {
+        if (frame < frames) {
+            chip->keys_pressed = (keys[frame * 2] << 8) | keys[frame * 2 + 1];
+        }
+        run_frame(chip, FUZZ_CYCLES_PER_FRAME);
+    }
+
+    return 0;
+}
+
+#ifndef FUZZ_LIBFUZZER
+static uint8_t input[MAXIMUM_INPUT];
+
+static size_t read_input(FILE *fp) {
+    return fread(input, 1, sizeof(input), fp);
+}
+
+int main(int argc, char *argv[]) {
+    // Replay each file given, handy for reproducing crashes
+    if (argc > 1) {
+        for (int i = 1; i < argc; i++) {
+            FILE *fp = fopen(argv[i], "rb");
+            if (fp == NULL) {
+                fprintf(stderr, "Failed to open %s\n", argv[i]);
+                return 1;
+            }
+
+            size_t size = read_input(fp);
+            fclose(fp);
+            LLVMFuzzerTestOneInput(input, size);
+        }
+        return 0;
+    }
+
+#ifdef __AFL_HAVE_MANUAL_CONTROL
+    // AFL's persistent mode, many inputs per process
+    while (__AFL_LOOP(10000)) {
+        LLVMFuzzerTestOneInput(input, read_input(stdin));
+    }
+#else
+    LLVMFuzzerTestOneInput(input, read_input(stdin));
+#endif
+
+    return 0;
+}
+#endif
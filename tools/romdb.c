@@ -0,0 +1,149 @@
+#include "consts.h"
+#include "hash.h"
+#include "romdb.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Builds a ROM database from a list of ROMs, one per line:
+//   <rom file> <cycles per frame> <quirks> [foreground] [background]
+// Quirks are vip, schip or xo and colours are the numbers -f and -b take.
+// Any field can be - to leave it up to the command line, lines starting with # are ignored
+
+#define MAXIMUM_LINE 1024
+
+static void usage() {
+    printf("Usage: ./romdb <output database> <rom list>\n");
+}
+
+static bool hash_file(char const *path, uint64_t *hash) {
+    static uint8_t buffer[XOCHIP_MEMORY_SIZE];
+
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        printf("Failed to open rom file %s\n", path);
+        return false;
+    }
+
+    size_t length = fread(buffer, 1, sizeof(buffer), fp);
+    fclose(fp);
+
+    *hash = xxh64(buffer, length, 0);
+    return true;
+}
+
+static bool parse_quirks(char const *text, uint8_t *quirks) {
+    if (strcmp(text, "-") == 0) {
+        *quirks = ROM_ENTRY_UNSET;
+    } else if (strcmp(text, "vip") == 0) {
+        *quirks = QUIRKS_VIP;
+    } else if (strcmp(text, "schip") == 0) {
+        *quirks = QUIRKS_SCHIP;
+    } else if (strcmp(text, "xo") == 0) {
+        *quirks = QUIRKS_XO;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+static bool parse_colour(char const *text, uint8_t *colour) {
+    if (text == NULL || strcmp(text, "-") == 0) {
+        *colour = ROM_ENTRY_UNSET;
+        return true;
+    }
+
+    long value = strtol(text, NULL, 10);
+    if (value < 1 || value > 16) return false;
+
+    *colour = (uint8_t) value;
+    return true;
+}
+
+static bool parse_line(char *line, RomEntry *entry) {
+    char *rom = strtok(line, " \t\n");
+    char *cycles = strtok(NULL, " \t\n");
+    char *quirks = strtok(NULL, " \t\n");
+    char *foreground = strtok(NULL, " \t\n");
+    char *background = strtok(NULL, " \t\n");
+
+    if (rom == NULL || cycles == NULL || quirks == NULL) {
+        return false;
+    }
+
+    memset(entry, 0, sizeof(RomEntry));
+    entry->cycles_per_frame = strcmp(cycles, "-") == 0 ? 0 : (uint32_t) strtoul(cycles, NULL, 10);
+
+    if (!parse_quirks(quirks, &entry->quirks) || !parse_colour(foreground, &entry->foreground) ||
+        !parse_colour(background, &entry->background)) {
+        return false;
+    }
+
+    if (!hash_file(rom, &entry->hash)) {
+        return false;
+    }
+
+    printf("%016llx %s\n", (unsigned long long) entry->hash, rom);
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    char line[MAXIMUM_LINE];
+    RomEntry *entries = NULL;
+    uint32_t count = 0;
+    uint32_t capacity = 0;
+    int line_number = 0;
+    int result = 0;
+
+    if (argc != 3) {
+        usage();
+        return 1;
+    }
+
+    FILE *fp = fopen(argv[2], "r");
+    if (fp == NULL) {
+        printf("Failed to open rom list %s\n", argv[2]);
+        return 1;
+    }
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        line_number++;
+
+        char *start = line + strspn(line, " \t");
+        if (*start == '#' || *start == '\n' || *start == '\0') continue;
+
+        if (count == capacity) {
+            capacity = capacity == 0 ? 64 : capacity * 2;
+            RomEntry *grown = realloc(entries, capacity * sizeof(RomEntry));
+            if (grown == NULL) {
+                printf("ERROR: Failed to assign memory for the database\n");
+                result = 1;
+                break;
+            }
+            entries = grown;
+        }
+
+        if (!parse_line(start, &entries[count])) {
+            printf("Invalid entry on line %d\n", line_number);
+            result = 1;
+            break;
+        }
+        count++;
+    }
+
+    fclose(fp);
+
+    if (result == 0 && !write_rom_database(argv[1], entries, count)) {
+        result = 1;
+    }
+
+    if (result == 0) {
+        printf("Wrote %u entries to %s\n", count, argv[1]);
+    }
+
+    free(entries);
+    return result;
+}
@@ -0,0 +1,134 @@
+#include "chip8.h"
+#include "consts.h"
+#include "scheduler.h"
+#include "structs.h"
+#include "timing.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Checks sessions waiting on FX0A park and cost nothing, then wake and carry on once their keys
+// change. Every session runs F00A (wait for a key into V0) then loops on 1202, which never parks
+
+#define SESSIONS 64
+#define WORKERS 4
+#define CYCLES_PER_FRAME 10
+#define TIMEOUT (2 * NANOSECS_IN_SECOND)
+#define PRESSED_KEY 5
+
+static uint8_t const ROM[] = { 0xF0, 0x0A, 0x12, 0x02 };
+
+static void sleep_milliseconds(long milliseconds) {
+    struct timespec duration = { 0, milliseconds * 1000000 };
+    nanosleep(&duration, NULL);
+}
+
+// Waits for the number of parked sessions to reach parked, returns false if it never does
+static bool wait_for_parked(Scheduler *scheduler, int64_t parked) {
+    uint64_t give_up = now_nanoseconds() + TIMEOUT;
+
+    while (atomic_load(&scheduler->parked) != parked) {
+        if (now_nanoseconds() > give_up) {
+            printf("FAIL  expected %lld parked sessions, have %lld\n", (long long) parked,
+                   (long long) atomic_load(&scheduler->parked));
+            return false;
+        }
+        sleep_milliseconds(1);
+    }
+
+    return true;
+}
+
+static bool run(Scheduler *scheduler, Session *sessions) {
+    // Everything parks on its first frame
+    if (!wait_for_parked(scheduler, SESSIONS)) return false;
+
+    uint64_t frames = atomic_load(&scheduler->frames);
+    sleep_milliseconds(100);
+    if (atomic_load(&scheduler->frames) != frames) {
+        printf("FAIL  parked sessions are still running frames\n");
+        return false;
+    }
+    printf("PASS  %d sessions parked on FX0A and stopped running\n", SESSIONS);
+
+    // FX0A takes the key when it's let go, so a press wakes them only to park again
+    for (int i = 0; i < SESSIONS; i++) {
+        set_session_keys(scheduler, &sessions[i], 1 << PRESSED_KEY);
+    }
+    if (!wait_for_parked(scheduler, SESSIONS)) return false;
+    if (atomic_load(&scheduler->parks) < 2 * SESSIONS) {
+        printf("FAIL  pressing a key didn't wake the sessions\n");
+        return false;
+    }
+
+    for (int i = 0; i < SESSIONS; i++) {
+        set_session_keys(scheduler, &sessions[i], 0);
+    }
+    if (!wait_for_parked(scheduler, 0)) return false;
+
+    frames = atomic_load(&scheduler->frames);
+    sleep_milliseconds(100);
+    if (atomic_load(&scheduler->frames) == frames) {
+        printf("FAIL  woken sessions aren't running\n");
+        return false;
+    }
+    printf("PASS  releasing the key woke every session\n");
+
+    return true;
+}
+
+int main(void) {
+    Scheduler scheduler;
+    Session sessions[SESSIONS] = { 0 };
+    bool passed = true;
+
+    Chip8 *chip = create_chip8(NULL, MODE_CHIP8, QUIRKS_VIP, WHITE, BLACK);
+    if (chip == NULL || load_rom_from_buffer(chip, ROM, sizeof(ROM))) {
+        printf("ERROR: Failed to create the test machine\n");
+        return 1;
+    }
+
+    for (int i = 0; i < SESSIONS; i++) {
+        sessions[i].chip = malloc(chip8_size(chip));
+        if (sessions[i].chip == NULL) {
+            printf("ERROR: Failed to assign memory for session %d\n", i);
+            return 1;
+        }
+        copy_chip8(sessions[i].chip, chip);
+        sessions[i].cycles_per_frame = CYCLES_PER_FRAME;
+    }
+
+    if (!start_scheduler(&scheduler, WORKERS)) {
+        return 1;
+    }
+
+    for (int i = 0; i < SESSIONS; i++) {
+        if (!schedule_session(&scheduler, &sessions[i])) {
+            return 1;
+        }
+    }
+
+    passed = run(&scheduler, sessions);
+    stop_scheduler(&scheduler);
+
+    // The machines can only be looked at once the workers have stopped
+    for (int i = 0; passed && i < SESSIONS; i++) {
+        if (sessions[i].chip->registers[0] != PRESSED_KEY || sessions[i].chip->pc != 0x202) {
+            printf("FAIL  session %d got V0=%d at pc %03X\n", i, sessions[i].chip->registers[0], sessions[i].chip->pc);
+            passed = false;
+        }
+    }
+    if (passed) {
+        printf("PASS  every session got key %X and moved past FX0A\n", PRESSED_KEY);
+    }
+
+    for (int i = 0; i < SESSIONS; i++) {
+        free(sessions[i].chip);
+    }
+    cleanup_chip8(chip);
+
+    return passed ? 0 : 1;
+}